@@ -0,0 +1,13 @@
+// LoRa time-on-air, per the Semtech SX1276 datasheet (section 4.1.1.7).
+
+#ifndef AIRTIME_H
+#define AIRTIME_H
+
+#include <stdint.h>
+
+// Explicit header, CRC off (the arduino-LoRa default). Low data rate
+// optimization is assumed on whenever a symbol lasts longer than 16 ms, as
+// arduino-LoRa configures it. cr4 is the coding rate denominator (5..8).
+uint32_t loraTimeOnAirUs(uint8_t payloadLen, uint8_t sf, uint32_t bwHz, uint8_t cr4, uint16_t preambleLen);
+
+#endif // AIRTIME_H
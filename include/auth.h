@@ -0,0 +1,62 @@
+// Authenticated panics and ACKs (AUTH_FRAMES in config.h).
+//
+// All units hold the same AUTH_KEY_LEN-byte key in EEPROM. Panics and ACKs
+// we send carry a frame counter and a tag over it (the auth TLV, frame.h).
+// A received panic or ACK only counts when its tag is right under our key
+// and its counter is above the last one accepted from that node, so a
+// recorded frame cannot be played back later. The counter is the boot count
+// (EEPROM) in the top 16 bits and the frames sent since boot below, so it
+// keeps growing across restarts; the boot count is written back a byte per
+// loop() pass, like the journal.
+//
+// Limits: the last counters heard live in the node table, in RAM. A unit
+// that restarted, or evicted the sender from the table, takes the next valid
+// frame from it whatever its counter, so an old recording can be replayed to
+// it once. And as the key is shared, any unit holding it can send as any
+// node ID.
+
+#ifndef AUTH_H
+#define AUTH_H
+
+#include <stdint.h>
+#include "config.h"
+#include "frame.h"
+#include "node_table.h"
+
+#ifdef AUTH_FRAMES
+// Load the key and count this boot
+void authBegin();
+// Write the boot count out once the EEPROM is free; call every loop() pass
+void authService();
+
+// False while the key is unset (erased EEPROM): frames then go out
+// without the auth TLV and every received panic and ACK is refused
+bool authHasKey();
+
+// Give a panic or ACK of ours the next counter and its tag
+void authSign(Frame &f);
+
+// Whether a received panic or ACK counts. node is its sender's table entry,
+// NULL if not in the table; authAccepted() records the counter once it is.
+// copy: the duplicate cache holds the frame (relaySeen). A copy of the frame
+// last accepted from node, direct or relayed, carries its counter again and
+// is let through to be handled as a duplicate, not refused as a replay.
+bool authCheck(const Frame &f, const NodeEntry *node, bool copy);
+void authAccepted(const Frame &f, NodeEntry &node);
+
+// Serial key entry: 'K' and AUTH_KEY_LEN * 2 hex digits. True while c was
+// taken as part of it; the key is stored when the last digit arrives.
+bool authKeyInput(int c);
+
+// Microseconds for AUTH_BENCH_TAGS tags back to back ('a' on the serial
+// console), timed with micros(): 4 us steps on the AVR
+#define AUTH_BENCH_TAGS 16
+uint32_t authBenchMicros();
+
+// Counters since boot: panics and ACKs refused for a bad or missing tag,
+// and for an old counter
+uint16_t authBadTags();
+uint16_t authReplays();
+#endif
+
+#endif // AUTH_H
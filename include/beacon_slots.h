@@ -0,0 +1,71 @@
+// Slotted beacons (TDMA_BEACONS in config.h).
+//
+// Time is cut into superframes of TDMA_SLOTS slots of TDMA_SLOT_MS. Every
+// unit sends one beacon per superframe, starting at a random point in the
+// first TDMA_JITTER_MS of its own slot. Slot 0 carries no beacons, so alerts
+// always find a quiet stretch of channel.
+//
+// Beacons carry the sender's position in its superframe (the time TLV in
+// frame.h), stamped just before they go on air. A receiver adds the frame's
+// time on air to it and knows where the sender's superframe is now. The
+// network follows the clock of the lowest node ID (the root): a unit takes
+// over the clock of any beacon with a lower root than its own, or with the
+// same root reached fewer superframes ago (the age). The age grows by one
+// each superframe, so when the root goes quiet the units fall back to their
+// own clocks after TDMA_SYNC_MAX_AGE superframes and the next lowest ID
+// takes over.
+//
+// A unit does not beacon in its first superframe, to pick up the network's
+// clock first. Two units in the same slot find out through listen before
+// talk: the later one's CAD finds the channel busy and it receives the
+// other's beacon instead. It then moves to a slot nobody was heard in during
+// the last few superframes. A beacon that can no longer end inside its slot
+// (busy channel, queued behind alerts) is dropped rather than sent into
+// someone else's slot. A beacon with a name needs the next slot as well, so
+// it only carries the name when that slot is free.
+
+#ifndef BEACON_SLOTS_H
+#define BEACON_SLOTS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "frame.h"
+
+#ifdef TDMA_BEACONS
+#define TDMA_SUPERFRAME_MS ((uint32_t)TDMA_SLOTS * TDMA_SLOT_MS)
+
+// Start out on our own clock, in slot 1 + nodeId % (TDMA_SLOTS - 1)
+void slotsBegin(uint8_t nodeId, uint32_t now);
+
+// When our next beacon is due, after the current one if now is in our slot
+uint32_t slotsNextBeaconAt(uint32_t now);
+
+// Whether a beacon carrying a name of nameLen characters still fits: the
+// extra slots it runs into were free during the last few superframes
+bool slotsRoomForName(uint8_t nameLen);
+
+// Fill in the time TLV of a beacon to queue; slotsStamp() updates it
+void slotsSetTime(Frame &f, uint32_t now);
+
+// Called by the transmit queue just before an encoded frame goes on air:
+// our own beacon gets the current superframe position. False if it can no
+// longer end inside its slot and has to be dropped.
+bool slotsStamp(uint8_t *data, uint8_t len, uint32_t now);
+
+// A beacon from another unit, len bytes on air, received now. True if our
+// beacon times moved (new clock or new slot): re-arm the beacon task.
+bool slotsHeard(const Frame &f, uint8_t len, uint32_t now);
+
+// Current slot, the root node our clock follows and its age
+uint8_t slotsOwn();
+uint8_t slotsRoot();
+uint8_t slotsAge();
+// Counters since boot: changes of root, slot moves, beacons dropped for
+// missing their slot, and the last clock correction from a beacon
+uint16_t slotsResyncs();
+uint16_t slotsMoves();
+uint16_t slotsMissed();
+int16_t slotsLastCorrectionMs();
+#endif
+
+#endif // BEACON_SLOTS_H
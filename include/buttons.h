@@ -0,0 +1,45 @@
+// Button scanning and debouncing.
+//
+// All five buttons are sampled together (hal::readButtons() reads the port
+// registers) every BUTTON_SAMPLE_MS and debounced in parallel by a 2-bit
+// vertical counter: a bit must read the same for 4 consecutive samples before
+// the debounced state toggles. Pin-change interrupts stamp every raw edge, so
+// press/release events carry the time the contact actually closed/opened and
+// long-press timing starts from there.
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <stdint.h>
+#include "config.h"
+
+#define BUTTON_COUNT 5
+// 4 samples per decision keeps the confirmation window near DEBOUNCE_MS
+#define BUTTON_SAMPLE_MS (DEBOUNCE_MS / 4)
+
+enum ButtonEventType
+{
+    BUTTON_PRESS,
+    BUTTON_RELEASE,
+    BUTTON_LONG_PRESS
+};
+
+struct ButtonEvent
+{
+    uint8_t type;
+    uint8_t button; // 0-based
+    uint16_t atMs;  // low 16 bits of millis() at the originating edge
+};
+
+void buttonsBegin();
+
+// One pass: sample/debounce if due and check long presses. Writes at most
+// one event per button into out (BUTTON_COUNT entries) and returns the count.
+uint8_t buttonsPoll(uint32_t now, ButtonEvent *out);
+
+// Debounced state: bit i set while button i is held
+uint8_t buttonsHeld();
+// No button held, bouncing or waiting to be debounced
+bool buttonsIdle();
+
+#endif // BUTTONS_H
@@ -0,0 +1,36 @@
+// Buzzer pattern sequencer.
+//
+// Patterns are tables of (frequency, duration) steps in flash. A timer
+// interrupt every ~1 ms (hal::tickBegin) walks them and reprograms the tone
+// generator (hal::buzzerTone: Timer1 toggling OC1B on the board), so the
+// cadence stays exact however long a loop() pass takes. A one-shot pattern
+// plays over the looping background pattern (the panic siren), which then
+// starts again.
+//
+// BUZZER_ENABLED (config.h, off with -DQUIET_DEBUG) keeps it silent.
+
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <stdint.h>
+
+enum BuzzerPattern
+{
+    BUZZER_SILENT,
+    BUZZER_BEEP,  // key click / frame heard
+    BUZZER_SIREN, // panic, looped
+    BUZZER_CHIRP  // our panic was acknowledged
+};
+
+// Start the tick; the buzzer is silent
+void buzzerBegin();
+
+// Play a pattern once, interrupting the background
+void buzzerPlay(uint8_t pattern);
+// Background pattern, repeated until replaced (BUZZER_SILENT stops it)
+void buzzerLoop(uint8_t pattern);
+
+// A pattern is playing, one-shot or background
+bool buzzerSounding();
+
+#endif // BUZZER_H
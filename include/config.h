@@ -0,0 +1,354 @@
+// Build-time configuration shared by the sketch and the hardware abstraction layer.
+// Role, pin map, radio profile, feature switches and operational constants
+// live here so that both the AVR and the host-native HAL see the same values.
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+
+// ============ ROLE ============
+// What the unit is for, one firmware per role (platformio.ini has an env for
+// each, e.g. -DUNIT_ROLE=ROLE_SENDER). The code a role does not need sits
+// behind `if (ROLE.flag)` on the constexpr flags below, so the compiler drops
+// it and the linker the functions only it called.
+//   ROLE_FULL     every unit sends, shows and acknowledges alerts (default)
+//   ROLE_SENDER   panic and button 4 presses; shows only its own panic
+//   ROLE_CONSOLE  shows and acknowledges the others' alerts, sends none
+//   ROLE_RELAY    repeats the others' frames (RELAY_MODE) and nothing else
+#define ROLE_FULL 0
+#define ROLE_SENDER 1
+#define ROLE_CONSOLE 2
+#define ROLE_RELAY 3
+#ifndef UNIT_ROLE
+#define UNIT_ROLE ROLE_FULL
+#endif
+
+struct RoleConfig
+{
+    bool sendsAlerts;    // panic button, button 4 press/release frames
+    bool receivesAlerts; // shows, sounds and acknowledges the others' panics and presses
+};
+
+constexpr RoleConfig roleConfig(uint8_t role)
+{
+    return role == ROLE_SENDER    ? RoleConfig{true, false}
+           : role == ROLE_CONSOLE ? RoleConfig{false, true}
+           : role == ROLE_RELAY   ? RoleConfig{false, false}
+                                  : RoleConfig{true, true};
+}
+
+constexpr RoleConfig ROLE = roleConfig(UNIT_ROLE);
+
+// What the buttons do outside naming mode (0-based index into PinMap::button)
+constexpr uint8_t BUTTON_NAME = 2;  // long press enters/leaves naming mode
+constexpr uint8_t BUTTON_SEND = 3;  // press/release frames while held
+constexpr uint8_t BUTTON_PANIC = 4;
+
+// ============ PIN MAPS ============
+struct PinMap
+{
+    uint8_t button[5]; // active LOW with INPUT_PULLUP, D0-D13
+    uint8_t buzzer;    // D10 only: the tone comes from Timer1's OC1B
+    uint8_t loraSs;
+    uint8_t loraRst;
+    uint8_t loraDio0;  // an external interrupt pin, D2 or D3
+};
+
+// The prototype: CS on A1, RST on D2, DIO0 on D3
+constexpr PinMap PINS_NANO = {{8, 4, 5, 6, 7}, 10, 15, 2, 3};
+// Buttons on D3-D7, CS on A1, RST on D9, DIO0 on D2
+constexpr PinMap PINS_NANO_D2 = {{3, 4, 5, 6, 7}, 10, 15, 9, 2};
+
+// Board wiring, e.g. -DPIN_MAP=PINS_NANO_D2
+#ifndef PIN_MAP
+#define PIN_MAP PINS_NANO
+#endif
+constexpr PinMap PINS = PIN_MAP;
+
+// I2C LCD address and dimensions
+#define I2C_LCD_ADDR 0x27
+#define LCD_COLS 16
+#define LCD_ROWS 2
+// Uncomment to run the LCD's I2C bus at 400 kHz instead of 100 kHz. That is
+// beyond the PCF8574's rating, but most backpacks take it; check the display.
+//#define LCD_I2C_FAST
+
+// ============ LORA CONFIG ============
+// Uncomment to enable LoRa functionality (requires LoRa lib in platformio.ini)
+#define USE_LORA
+
+#ifdef USE_LORA
+// Radio profiles; every unit of a network needs the same one
+struct RadioProfile
+{
+    int8_t txPowerDbm;       // 2-20 dBm
+    uint32_t bandwidthHz;
+    uint8_t spreadingFactor; // 6-12
+    uint8_t codingRate;      // 4/5 .. 4/8
+};
+
+// ~2 km with responsive beeps: max power, SF12 (~1.5 s per packet)
+constexpr RadioProfile RADIO_LONG_RANGE = {20, 125000, 12, 8};
+// Within a building: SF9 and 4/5 coding, about 9x less time on air
+constexpr RadioProfile RADIO_SHORT_RANGE = {14, 125000, 9, 5};
+
+// e.g. -DRADIO_PROFILE=RADIO_SHORT_RANGE
+#ifndef RADIO_PROFILE
+#define RADIO_PROFILE RADIO_LONG_RANGE
+#endif
+constexpr RadioProfile RADIO = RADIO_PROFILE;
+static_assert(RADIO.spreadingFactor >= 6 && RADIO.spreadingFactor <= 12, "spreading factor must be 6-12");
+static_assert(RADIO.codingRate >= 5 && RADIO.codingRate <= 8, "coding rate must be 4/5..4/8");
+
+// Uncomment on EVERY unit of a network with battery-powered units (the
+// preamble length is a network-wide setting). Between events the MCU then
+// sits in power-down and the radio sleeps, waking every
+// BATTERY_CAD_PERIOD_MS for a channel activity detection (CAD). Every frame
+// carries a preamble of BATTERY_NOTICE_MS, so a sleeping unit is listening
+// by the time the payload follows. Beacons are off. Estimated currents are in
+// WIRING.md.
+//#define BATTERY_MODE
+#ifdef BATTERY_MODE
+// Worst case from the start of a frame until a sleeping unit has noticed it;
+// also the time every frame spends on the preamble (SF12: 1 symbol = 33 ms)
+#define BATTERY_NOTICE_MS 2000
+// Leaves room for the watchdog running up to ~10% slow and the CAD itself
+// (2 symbols); the watchdog rounds it down to 1, 2, 4 or 8 s, or 16..500 ms
+#define BATTERY_CAD_PERIOD_MS (BATTERY_NOTICE_MS * 3 / 4)
+// Stay in receive this long after activity was detected and after anything
+// happened (press, frame, transmit), e.g. for an ACK or a release
+#define BATTERY_LISTEN_MS (BATTERY_NOTICE_MS + 2000)
+#define LORA_PREAMBLE_LEN ((uint16_t)(BATTERY_NOTICE_MS * (RADIO.bandwidthHz / 1000) / (1UL << RADIO.spreadingFactor)))
+#else
+#define LORA_PREAMBLE_LEN 8    // arduino-LoRa default
+#endif
+
+// Migration: also accept the old ASCII frames ("P4|NAME", "X|NAME", ...)
+// from units that have not been reflashed with the binary format yet
+#define ACCEPT_LEGACY_FRAMES
+// Frames that carry the name TLV after boot or a name change
+#define NAME_ANNOUNCE_FRAMES 3
+// Every Nth beacon and panic frame re-sends the name for late joiners
+#define NAME_REFRESH_BEACONS 12
+#define NAME_REFRESH_PANIC 4
+
+// Uncomment on EVERY unit to authenticate panics and ACKs with a pre-shared
+// key (auth.h): they carry a counter and a tag, and units ignore panics and
+// ACKs without a valid one, the legacy "X|..." panic included. Give every
+// unit the same key over serial: K and 32 hex digits. Costs 10 bytes per
+// panic and ACK (+524 ms on air at SF12) and ~140 bytes of RAM, so raise
+// custom_ram_budget in platformio.ini for such a build.
+//#define AUTH_FRAMES
+
+// Uncomment on every unit of a multi-hop network: each unit then repeats
+// panic, press/release and ACK frames it hears first-hand once, so alerts
+// reach units beyond one hop. Presses also get a sequence number (+262 ms
+// on air at SF12) so copies can be told apart.
+//#define RELAY_MODE
+#if UNIT_ROLE == ROLE_RELAY && !defined(RELAY_MODE)
+#define RELAY_MODE
+#endif
+// Times a frame may be repeated on its way from the originating unit
+#define RELAY_HOP_LIMIT 3
+// Remembered (origin, sequence number) pairs and how long a copy heard
+// again counts as a duplicate. Without RELAY_MODE the only copies are the
+// ones relay units repeat, so fewer pairs do.
+#ifdef RELAY_MODE
+#define RELAY_CACHE_SLOTS 8
+#else
+#define RELAY_CACHE_SLOTS 4
+#endif
+#define RELAY_CACHE_TTL_MS 6000
+// Without AUTH_FRAMES, for panics: below PANIC_RETRY_MS, so that a retry of
+// the sender is not taken for a copy of the previous transmission
+#define RELAY_PANIC_TTL_MS (PANIC_RETRY_MS * 4 / 5)
+// Repeats go out in one of RELAY_BACKOFF_SLOTS random slots of about one
+// frame time on air, so neighbours relaying the same frame rarely collide
+#define RELAY_BACKOFF_SLOTS 4
+#define RELAY_SLOT_MS 1000
+
+// Listen before talk: every transmit is preceded by a channel activity
+// detection (CAD, ~2 symbols). If the channel is busy the radio goes back to
+// receive and the frame waits 1..LBT_BACKOFF_SLOTS slots of LBT_SLOT_MS,
+// the window doubling with each busy CAD up to 8x; after LBT_MAX_TRIES busy
+// CADs it goes out anyway. Comment out (or build with -DNO_LISTEN_BEFORE_TALK,
+// as tools/sim/sweep.sh does for comparison) to transmit blind.
+#ifndef NO_LISTEN_BEFORE_TALK
+#define LISTEN_BEFORE_TALK
+#endif
+#define LBT_SLOT_MS 250
+#define LBT_BACKOFF_SLOTS 4
+#define LBT_MAX_TRIES 6
+
+// Uncomment on EVERY unit to send beacons in time slots instead of every
+// BEACON_INTERVAL_MS on each unit's own clock. A superframe of TDMA_SLOTS
+// slots of TDMA_SLOT_MS is shared by the network, following the clock of
+// the lowest node ID heard; beacons carry the sender's position in it (+262
+// ms on air at SF12). Each unit beacons once per superframe in its own slot,
+// which starts out as 1 + node ID % (TDMA_SLOTS - 1). Slot 0 is left free
+// for alerts; panics, ACKs and presses go out whenever they are due. Up to
+// TDMA_SLOTS - 1 units beacon without colliding. See beacon_slots.h.
+//#define TDMA_BEACONS
+#ifdef TDMA_BEACONS
+// A 7-byte beacon at SF12 (925 ms) after up to TDMA_JITTER_MS and a CAD
+// (66 ms), with ~100 ms left for clock drift between syncs
+#define TDMA_SLOT_MS 1200
+// 2..32; more slots carry more units but space each unit's beacons further
+// apart (can be overridden with -D for the channel simulator)
+#ifndef TDMA_SLOTS
+#define TDMA_SLOTS 16
+#endif
+// Random start within the slot, so two units that ended up in the same slot
+// notice each other with their CAD
+#define TDMA_JITTER_MS 100
+// Superframes a unit keeps following a root it no longer hears (through any
+// chain of units) before falling back to its own clock
+#define TDMA_SYNC_MAX_AGE 7
+#ifdef BATTERY_MODE
+#error "BATTERY_MODE sends no beacons, TDMA_BEACONS does not apply"
+#endif
+#ifndef LISTEN_BEFORE_TALK
+#error "TDMA_BEACONS finds units sharing a slot through LISTEN_BEFORE_TALK"
+#endif
+#endif
+
+// Beacons carry a state snapshot (state TLV, frame.h): buttons held, own
+// panic, supply voltage and a check of the name, +262 ms on air at SF12.
+// It goes out while button 4 is held, once after it is let go or our panic
+// started, else with every STATE_REFRESH_BEACONS-th beacon. Receivers follow a
+// sender's presses and name from it, and raise a panic they missed. While
+// button 4 is held, a state beacon every HOLD_REFRESH_MS replaces the press
+// frame every HOLD_SEND_INTERVAL_MS, and a release or refresh that finds our
+// state beacon still waiting rides on it instead of going out alone. The
+// longer frame slots cost ~40 bytes of RAM. Build with -DNO_STATE_BEACONS
+// (tools/sim/sweep.sh STATE=off) to compare. Slotted beacons have no room
+// left in their slot for it.
+#if !defined(NO_STATE_BEACONS) && !defined(TDMA_BEACONS)
+#define STATE_BEACONS
+#endif
+#ifdef STATE_BEACONS
+#define STATE_REFRESH_BEACONS 6
+#define HOLD_REFRESH_MS 2500
+// A press heard from a unit that sends state ends this long after the last
+// frame from it, unless a release or a snapshot ends it first
+#define HOLD_REFRESH_TIMEOUT_MS (2 * HOLD_REFRESH_MS + 1000)
+#endif
+#elif UNIT_ROLE != ROLE_FULL
+#error "UNIT_ROLE needs USE_LORA"
+#endif
+
+// Longest frame the radio queues take: the codec's longest (frame.h), with
+// AUTH_FRAMES plus the auth TLV
+#ifdef AUTH_FRAMES
+#define RADIO_FRAME_MAX (FRAME_MAX_LEN + FRAME_AUTH_TLV_LEN)
+#else
+#define RADIO_FRAME_MAX FRAME_MAX_LEN
+#endif
+
+// ============ OPERATIONAL CONSTANTS ============
+const unsigned long DEBOUNCE_MS = 10;
+const unsigned long BAUD_RATE = 9600;
+const unsigned long LORA_FREQ = 915E6;  // 915 MHz
+const unsigned int BEEP_DURATION_MS = 80;
+const unsigned int BEEP_FREQ_HZ = 500; // Change to 4000 in the future
+// Build with -DQUIET_DEBUG to keep the buzzer silent at the desk; like the
+// role flags it is tested with `if`, and the compiler drops what it turns off
+#ifdef QUIET_DEBUG
+constexpr bool BUZZER_ENABLED = false;
+#else
+constexpr bool BUZZER_ENABLED = true;
+#endif
+// The intervals below set how busy the channel gets with many units; they
+// can be overridden with -D for the channel simulator (tools/sim)
+// How often the transmitter re-sends the 'pressed' packet while a button is held (ms)
+#ifndef HOLD_SEND_INTERVAL_MS
+#define HOLD_SEND_INTERVAL_MS 200
+#endif
+// How often a held button 4 is refreshed on air: a press frame, or with
+// STATE_BEACONS a state beacon
+#ifdef STATE_BEACONS
+#define HOLD_RESEND_MS HOLD_REFRESH_MS
+#else
+#define HOLD_RESEND_MS HOLD_SEND_INTERVAL_MS
+#endif
+// Silent test packet for the link display
+#ifndef BEACON_INTERVAL_MS
+#define BEACON_INTERVAL_MS 5000
+#endif
+// Our panic: first retry, covering panic + ACK time-on-air and the ACK jitter
+#ifndef PANIC_RETRY_MS
+#define PANIC_RETRY_MS 2500
+#endif
+#define PANIC_RETRY_MAX_MS 8000  // retries back off exponentially up to this
+#define PANIC_RETRY_JITTER_MS 1000  // random extra so units that panic together drift apart
+#define PANIC_KEEPALIVE_MS 30000  // repeat interval once delivered
+// How long the receiver will keep showing a received press without updates before clearing (ms)
+#define RECEIVE_TIMEOUT_MS 1000
+// Naming constants
+#define NAME_MAX_LEN 12
+#define NAME_EEPROM_ADDR 0
+// Short node ID carried in binary frames instead of the name (1..254)
+#define NODE_ID_EEPROM_ADDR (NAME_EEPROM_ADDR + NAME_MAX_LEN)
+// Remote units tracked at once (node_table.h); their names are kept in
+// EEPROM, NAME_MAX_LEN bytes per table slot
+#define NODE_TABLE_SLOTS 8
+#define NODE_NAMES_EEPROM_ADDR (NODE_ID_EEPROM_ADDR + 1)
+// Event journal (journal.h) in the rest of the EEPROM, 512 bytes on the ATmega168
+#define JOURNAL_EEPROM_ADDR (NODE_NAMES_EEPROM_ADDR + NODE_TABLE_SLOTS * NAME_MAX_LEN)
+#ifdef AUTH_FRAMES
+// Pre-shared key and the boot count of the frame counter (auth.h) at the end
+#define AUTH_KEY_LEN 16
+#define AUTH_KEY_EEPROM_ADDR (512 - AUTH_KEY_LEN - 2)
+#define AUTH_BOOTS_EEPROM_ADDR (AUTH_KEY_EEPROM_ADDR + AUTH_KEY_LEN)
+#define JOURNAL_EEPROM_END AUTH_KEY_EEPROM_ADDR
+#else
+#define JOURNAL_EEPROM_END 512
+#endif
+#define LONG_PRESS_MS 1000
+
+// Uncomment to time the phases of loop() and the panic press-to-transmit
+// latency into histograms ('p' on the serial console prints them). Costs
+// about 300 bytes of RAM, so raise custom_ram_budget in platformio.ini for
+// such a build.
+//#define USE_PROFILER
+
+// Serial log (log.h): messages up to this level are built in, LOG_ERROR,
+// LOG_WARN, LOG_INFO or LOG_DEBUG. Lines that do not fit in the UART's TX
+// buffer are dropped and counted instead of waiting for it.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_INFO
+#endif
+
+// Uncomment to turn the serial port into a binary telemetry stream
+// (telemetry.h) at TELEMETRY_BAUD: events, received frames with their RSSI
+// and SNR, and loop statistics every TELEMETRY_PERIOD_MS. Log messages are
+// not sent then; tools/telemetry_decode.py turns the stream into CSV.
+//#define TELEMETRY
+#define TELEMETRY_BAUD 115200
+#define TELEMETRY_PERIOD_MS 1000
+
+// Counters and timings that only feed the 's' serial command: queue, LCD,
+// radio, relay, log and scheduler statistics, boot times. About 90 bytes of
+// RAM; -DNO_STATS leaves them out and 's' prints what is left. The
+// telemetry records need them.
+#if !defined(NO_STATS) || defined(TELEMETRY)
+#define STATS
+#endif
+#ifdef STATS
+#define STAT_INC(counter) (++(counter))
+#define STAT_ADD(counter, n) ((counter) += (n))
+#else
+#define STAT_INC(counter) ((void)0)
+#define STAT_ADD(counter, n) ((void)0)
+#endif
+
+// Entries in the scheduler table (scheduler.h): exactly the sketch's tasks,
+// as every entry costs RAM
+#ifdef TELEMETRY
+#define SCHED_MAX_TASKS 12
+#else
+#define SCHED_MAX_TASKS 11
+#endif
+
+#endif // CONFIG_H
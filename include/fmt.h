@@ -0,0 +1,14 @@
+// Fixed-width integer rendering without the printf family (vfprintf alone
+// would take a good part of the 168's flash).
+
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+// Decimal digits of value, right-aligned and space-padded to width (0 for
+// no padding). Writes no terminator; returns the number of chars written,
+// at most max(width, 5).
+uint8_t fmtUnsigned(char *out, uint16_t value, uint8_t width);
+
+#endif // FMT_H
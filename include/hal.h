@@ -0,0 +1,208 @@
+// Hardware abstraction layer.
+//
+// The sketch talks to GPIO, the buzzer, EEPROM, the serial port, the 1602 LCD
+// and the LoRa radio only through the functions below. On the board (ARDUINO
+// defined) they forward to the Arduino core and the LoRa library, and drive
+// the LCD through an interrupt-driven I2C queue (src/hal_avr.cpp). In the `native` PlatformIO env they are backed
+// by a simulated board with a virtual clock (src/hal_native.cpp, see sim.h).
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#else
+#include <string.h>
+typedef uint8_t byte;
+#ifndef HIGH
+#define HIGH 1
+#define LOW 0
+#endif
+// Constant strings and tables stay in flash on the board (PSTR, PROGMEM);
+// on the host flash is ordinary memory
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_ptr(p) (*(void *const *)(p))
+#define memcpy_P memcpy
+#endif
+
+namespace hal
+{
+#ifdef ARDUINO
+// Time and GPIO are on every hot path, keep them zero-cost on the board
+inline uint32_t millis() { return ::millis(); }
+inline uint32_t micros() { return ::micros(); }
+inline void delay(uint32_t ms) { ::delay(ms); }
+// Sleep until the next interrupt; IDLE keeps timers, UART, SPI and TWI running
+inline void idle()
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+}
+inline void pinInputPullup(uint8_t pin) { pinMode(pin, INPUT_PULLUP); }
+inline void pinOutput(uint8_t pin) { pinMode(pin, OUTPUT); }
+inline uint8_t readPin(uint8_t pin) { return digitalRead(pin); }
+inline void writePin(uint8_t pin, uint8_t level) { digitalWrite(pin, level); }
+
+static_assert(PINS.button[0] <= 13 && PINS.button[1] <= 13 && PINS.button[2] <= 13 && PINS.button[3] <= 13 &&
+                  PINS.button[4] <= 13,
+              "readButtons() expects the buttons on D0-D13 (PIND/PINB)");
+// Bit of an active-LOW button pin in the inverted PIND (D0-D7) / PINB (D8-D13)
+#define HAL_BUTTON_BIT(pin, index) \
+    ((((pin) < 8 ? pressedD >> (pin) : pressedB >> ((pin) - 8)) & 1) << (index))
+
+inline uint8_t readButtons()
+{
+    uint8_t pressedD = ~PIND;
+    uint8_t pressedB = ~PINB;
+    return HAL_BUTTON_BIT(PINS.button[0], 0) | HAL_BUTTON_BIT(PINS.button[1], 1) | HAL_BUTTON_BIT(PINS.button[2], 2) |
+           HAL_BUTTON_BIT(PINS.button[3], 3) | HAL_BUTTON_BIT(PINS.button[4], 4);
+}
+#else
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void idle();
+void pinInputPullup(uint8_t pin);
+void pinOutput(uint8_t pin);
+uint8_t readPin(uint8_t pin);
+void writePin(uint8_t pin, uint8_t level);
+uint8_t readButtons();
+#endif
+
+// readButtons(): bit i is set while button i+1 is held, all five taken from
+// one snapshot of the port registers.
+//
+// Pin-change interrupts on the button pins queue every raw change of that
+// mask, stamped with the low 16 bits of millis().
+struct ButtonEdge
+{
+    uint16_t atMs;
+    uint8_t mask;
+};
+void buttonEdgesBegin();
+bool buttonEdgePop(ButtonEdge &edge);
+
+// Buzzer on PINS.buzzer: square wave of freqHz (16 Hz and up), 0 for
+// silence. Only called from the tick.
+void buzzerTone(uint16_t freqHz);
+
+// Call fn from a timer interrupt every HAL_TICK_US; it must be short
+#ifdef ARDUINO
+#define HAL_TICK_US (64UL * 256 * 1000000UL / F_CPU) // Timer0 period, 1024 us at 16 MHz
+#else
+#define HAL_TICK_US 1000
+#endif
+void tickBegin(void (*fn)());
+
+// Unpredictable bits for IDs and random back-off
+uint16_t entropy();
+
+// Supply voltage (Vcc) in mV, measured against the internal 1.1 V bandgap
+// (+-10% uncalibrated); 0 if unknown. Takes two ADC conversions, ~0.2 ms.
+// It is the battery voltage only when the battery feeds Vcc without a
+// regulator in between.
+uint16_t supplyMillivolts();
+
+// EEPROM. eepromUpdate() first waits for a write still in progress (~3.3 ms
+// per byte on the AVR); eepromReady() tells whether it would have to.
+uint8_t eepromRead(uint16_t addr);
+void eepromUpdate(uint16_t addr, uint8_t value);
+bool eepromReady();
+
+// Serial console
+void serialBegin(uint32_t baud);
+// Next received byte, or -1 when none is waiting
+int serialRead();
+void serialPrint(const char *s);
+void serialPrint(long value);
+void serialPrintln(const char *s);
+// Same for a string in flash: serialPrint_P(PSTR("text"))
+void serialPrint_P(const char *s);
+void serialPrintln_P(const char *s);
+// The calls above wait while the UART's TX buffer is full, about 1 ms per
+// byte at 9600 baud. Bytes that fit right now, and a write of raw bytes
+// (only up to serialTxFree() of them go out without waiting).
+uint8_t serialTxFree();
+void serialWrite(const uint8_t *data, uint8_t len);
+
+// Power-down sleep (BATTERY_MODE) until a button, or until the watchdog
+// after at most maxMs (rounded down to 16 ms << n). Timer0 stops meanwhile;
+// a watchdog wake-up adds its period to millis(), and the time of a sleep
+// cut short by a button is lost. Returns the ms added.
+uint32_t powerDown(uint32_t maxMs);
+
+// Stack high-water mark. stackPaint(), first thing in setup(), fills the RAM
+// between the static data and the stack with a pattern; stackUnused() counts
+// the bytes the stack has never reached since. Not measured on the host.
+void stackPaint();
+uint16_t stackUnused();
+
+// 1602 LCD behind the I2C backpack. lcdBegin() runs the HD44780 power-on
+// sequence one step per call and returns how many ms to wait before the
+// next call, or 0 once the display is ready: blank, backlight on. The other
+// lcd functions must not be used before that.
+uint8_t lcdBegin();
+void lcdClear();
+void lcdSetCursor(uint8_t col, uint8_t row);
+void lcdPrint(char c);
+void lcdPrint(const char *s);
+void lcdBacklight(bool on);
+// On the board the calls above only queue the operation; the TWI interrupt
+// sends it. A call waits only when the queue is full, which counts as a
+// stall; lcdQueueFree() says how many calls fit without one.
+#define LCD_QUEUE_SLOTS 16
+uint8_t lcdQueueFree();
+// Every HD44780 command or character is two nibbles, each written to the
+// PCF8574 three times (data, E high, E low), plus an address byte per
+// transaction
+#define LCD_I2C_BYTES_PER_OP 6
+#ifdef STATS
+// Bytes put on the I2C bus by the calls above since boot, deepest queue,
+// stalls, and transactions the backpack did not answer (their queue is
+// dropped)
+uint32_t lcdI2cBytes();
+uint8_t lcdQueueDepthMax();
+uint16_t lcdQueueStalls();
+uint16_t lcdNackCount();
+#endif
+
+#ifdef USE_LORA
+// LoRa radio reset line, driven without waiting: hold it low for at least
+// RADIO_RESET_HOLD_MS, release it, and call radioBegin() no sooner than
+// RADIO_RESET_WAIT_MS later (SX127x: 100 us low, ready 5 ms after release).
+#define RADIO_RESET_HOLD_MS 1
+#define RADIO_RESET_WAIT_MS 6
+void radioReset(bool hold);
+// Applies the radio profile from config.h to a module fresh out of reset and
+// returns false if it did not answer. Takes a few SPI transfers, no delays.
+bool radioBegin(long freq);
+// Enter continuous receive. From then on the DIO0 RxDone interrupt moves
+// each frame with its RSSI/SNR into the RX queue (rx_queue.h), and the radio
+// returns to receive by itself after every transmit.
+void radioReceive();
+// True from radioSend() until the TxDone interrupt
+bool radioBusy();
+// Start transmitting one packet without waiting for TxDone; false (nothing
+// sent) while the previous packet is still on air. Use tx_queue.h.
+bool radioSend(const uint8_t *data, uint8_t len);
+// BATTERY_MODE: radioSleep() powers the radio down until the next
+// radioSniff(), radioReceive() or radioSend(). radioSniff() starts one
+// channel activity detection (also LISTEN_BEFORE_TALK, from receive);
+// radioSniffResult() is -1 until it is done, then 1 if a preamble was
+// heard, else 0. Either way the radio is in standby until told otherwise.
+void radioSleep();
+void radioSniff();
+int8_t radioSniffResult();
+#endif
+}
+
+#endif // HAL_H
@@ -0,0 +1,64 @@
+// Append-only event journal in EEPROM (panics, ACKs, link up/down, boots).
+//
+// The EEPROM from JOURNAL_EEPROM_ADDR to JOURNAL_EEPROM_END is a ring of
+// 8-byte records, each with a sequence number and a CRC-8. Records are
+// written round the whole ring, so every cell sees one write per
+// JOURNAL_SLOTS appends. At boot the newest record is found where the
+// sequence numbers stop counting up (or the CRC fails, e.g. a write cut by a
+// power loss), and appending continues after it.
+//
+// journalAppend() only queues the record in RAM; journalService() writes it
+// out one byte per loop() pass, and only while the EEPROM is not busy with
+// the previous byte, so no pass waits on the ~3.3 ms write time.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include "config.h"
+
+enum JournalEvent
+{
+    JOURNAL_BOOT,        // node: our node ID
+    JOURNAL_PANIC_SENT,  // our panic button; arg: panic sequence number
+    JOURNAL_PANIC_ACKED, // node: receiver that acknowledged it; arg: seq
+    JOURNAL_PANIC_HEARD, // node: unit in panic; arg: its sequence number
+    JOURNAL_LINK_UP,     // first frame after silence; rssi of that frame
+    JOURNAL_LINK_LOST    // nothing heard for RSSI_TIMEOUT
+};
+
+struct JournalRecord
+{
+    uint16_t deltaS; // seconds since the previous record of this boot (saturating)
+    uint8_t seq;
+    uint8_t type;
+    uint8_t node;
+    int8_t rssi; // dBm, 0 when not applicable
+    uint8_t arg;
+    uint8_t crc; // CRC-8 of the bytes before it
+};
+
+#define JOURNAL_SLOTS ((JOURNAL_EEPROM_END - JOURNAL_EEPROM_ADDR) / sizeof(JournalRecord))
+// Records that can wait for the EEPROM at once
+#define JOURNAL_QUEUE_SLOTS 2
+
+// Find the end of the ring; logs JOURNAL_BOOT
+void journalBegin(uint8_t node, uint32_t now);
+
+// Queue a record; false if JOURNAL_QUEUE_SLOTS records are still waiting
+bool journalAppend(uint8_t type, uint8_t node, int8_t rssi, uint8_t arg, uint32_t now);
+
+// Write the next queued byte if the EEPROM is free; call every loop() pass
+void journalService();
+bool journalPending();
+
+// Print the records on the serial console, oldest first
+void journalDump();
+
+// Short name of an event in flash ("panic", "up", ...), for the log
+const char *journalEventName(uint8_t type);
+
+// Records dropped because the queue was full, since boot
+uint16_t journalDropped();
+
+#endif // JOURNAL_H
@@ -0,0 +1,48 @@
+// Shadow framebuffer for the 1602 LCD.
+//
+// Drawing only touches a 32-byte copy of the display in RAM and marks the
+// cells it changes. fbFlush() later hands just the changed runs of cells to
+// the HAL's I2C queue (one setCursor per run), at most once per LCD_FRAME_MS
+// and at most LCD_FLUSH_MAX_OPS LCD writes per frame, never more than the
+// queue has room for, so a flush never waits on the bus.
+
+#ifndef LCD_FB_H
+#define LCD_FB_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Minimum time between flushes and LCD commands/characters sent per flush.
+// At 100 kHz one HD44780 write through the PCF8574 is ~0.55 ms of bus time.
+#define LCD_FRAME_MS 50
+#define LCD_FLUSH_MAX_OPS 16
+
+// Call once at boot. The shadow starts blank, as the display is once
+// hal::lcdBegin() is done; drawing may start right away, flushing only then.
+void fbBegin();
+
+// Blank the whole shadow / one row
+void fbClear();
+void fbClearRow(uint8_t row);
+// Write into the shadow at (col, row); text is clipped at the right edge
+void fbPutChar(uint8_t col, uint8_t row, char c);
+void fbPrint(uint8_t col, uint8_t row, const char *s);
+void fbPrintN(uint8_t col, uint8_t row, const char *s, uint8_t len);
+// Same for a string in flash: fbPrint_P(col, row, PSTR("text"))
+void fbPrint_P(uint8_t col, uint8_t row, const char *s);
+// Right-aligned unsigned number, space padded to width, clamped to fit
+void fbPrintNumber(uint8_t col, uint8_t row, uint8_t width, unsigned long value);
+
+// Push changed cells, honoring the frame rate and per-frame budget.
+// Returns true if anything was written.
+bool fbFlush(uint32_t now);
+// Queue everything outstanding right away, waiting for room in the I2C
+// queue if need be (the last screen before powering down)
+void fbFlushAll();
+
+#ifdef STATS
+// Bytes the LCD traffic put on the I2C bus during the last full second
+uint32_t fbI2cBytesPerSec();
+#endif
+
+#endif // LCD_FB_H
@@ -0,0 +1,58 @@
+// Leveled serial log that never waits on the UART.
+//
+// logBegin() only starts a message if the port's TX buffer has room for the
+// longest line (LOG_LINE_MAX plus level prefix and line end); the text then
+// goes straight into that buffer up to logEnd(), with no line buffer in RAM.
+// Otherwise the whole line is dropped and counted. At 9600 baud the TX
+// buffer drains about one byte per ms, so a burst of messages costs lines,
+// not a stalled loop():
+//
+//     if (LOG_ON(LOG_INFO))
+//     {
+//         logText_P(PSTR("Button "));
+//         logNumber(i + 1);
+//         logEnd();
+//     }
+//
+// Messages above LOG_LEVEL (config.h) compile away; the 'l' serial command
+// steps the level at run time. The replies to serial commands ('s', 'j',
+// 'p') are not log messages and still print in full. With TELEMETRY the
+// port carries binary records (telemetry.h) and log messages are not sent.
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include "config.h"
+
+#define LOG_ERROR 0
+#define LOG_WARN 1
+#define LOG_INFO 2
+#define LOG_DEBUG 3
+
+// Longest line, without the level prefix and line end; longer text is cut
+#define LOG_LINE_MAX 40
+// A whole line in the TX buffer: level letter, space, text, CR LF
+#define LOG_LINE_BYTES (1 + LOG_LINE_MAX + 2)
+
+// Start a message if level is compiled in and currently enabled, and the
+// line fits in the TX buffer right now
+#define LOG_ON(level) ((level) <= LOG_LEVEL && logBegin(level))
+bool logBegin(uint8_t level);
+void logText_P(const char *s);
+void logText(const char *s, uint8_t len);
+void logNumber(long value);
+// End the line started by logBegin()
+void logEnd();
+
+// Run-time level, LOG_ERROR..LOG_LEVEL
+void logSetLevel(uint8_t level);
+uint8_t logLevel();
+
+#ifdef STATS
+// Lines sent and dropped since boot
+uint16_t logWritten();
+uint16_t logDropped();
+#endif
+
+#endif // LOG_H
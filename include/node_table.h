@@ -0,0 +1,66 @@
+// Table of the remote units heard on the air, keyed by node ID.
+//
+// A fixed number of 10-byte entries in RAM holds what the display and the
+// timeouts need per sender: when it was last heard, its RSSI, whether it is
+// pressing or in panic, and a hash of its name (with STATE_BEACONS also its
+// supply voltage, 11 bytes; with AUTH_FRAMES the last frame counter accepted
+// from it, 4 bytes more). The names themselves live in
+// one EEPROM slot per table entry and are only rewritten when the hash
+// changes, a byte per loop() pass like the journal, so receiving a name never
+// waits for the EEPROM. One name is written at a time; a name announced
+// meanwhile by another node is dropped until it is announced again. A new
+// node takes a free entry or evicts the least recently heard one, sparing
+// entries in panic.
+
+#ifndef NODE_TABLE_H
+#define NODE_TABLE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// NodeEntry::state bits
+#define NODE_PRESSING 0x01
+#define NODE_PANIC 0x02
+#define NODE_SENDS_STATE 0x04 // heard a state TLV from it: presses are refreshed slower
+
+struct NodeEntry
+{
+    uint8_t id;       // FRAME_NODE_LEGACY collects all ASCII senders
+    uint8_t state;
+    int8_t rssi;      // dBm of the last frame heard directly from it
+    uint8_t panicSeq; // sequence number of its panic, while NODE_PANIC
+    uint32_t lastSeen;
+    uint16_t nameHash; // 0 while no name is known
+#ifdef STATE_BEACONS
+    uint8_t battery; // from its state TLV, FRAME_BATTERY_MV steps, 0 unknown
+#endif
+#ifdef AUTH_FRAMES
+    uint32_t authCounter; // last accepted, see auth.h
+#endif
+};
+
+void nodeTableBegin();
+
+// Entry for id, created when new; its lastSeen is set to now
+NodeEntry &nodeTouch(uint8_t id, uint32_t now);
+// Entry for id, NULL if not in the table
+NodeEntry *nodeFind(uint8_t id);
+// Entry in table slot i (0..NODE_TABLE_SLOTS-1), NULL if the slot is free
+NodeEntry *nodeAt(uint8_t slot);
+uint8_t nodeSlot(const NodeEntry &node);
+
+// Remember a name announced by the node (len characters, not terminated);
+// nodeTableService() writes it out
+void nodeSetName(NodeEntry &node, const char *name, uint8_t len);
+// Write the next byte of a pending name once the EEPROM is free; call every
+// loop() pass. nodeTablePending() is true while a name is still going out.
+void nodeTableService();
+bool nodeTablePending();
+// Drop the name, e.g. when the node's state TLV says it has changed; the
+// EEPROM slot is left as it is until the next nodeSetName() is written
+void nodeForgetName(NodeEntry &node);
+// Copy its name, NUL-terminated, into out (NAME_MAX_LEN + 1 bytes); returns
+// the length, 0 if no name is known
+uint8_t nodeName(const NodeEntry &node, char *out);
+
+#endif // NODE_TABLE_H
@@ -0,0 +1,54 @@
+// Loop-latency profiler (build with USE_PROFILER in config.h).
+//
+// Each phase of loop() is timed with micros() into a log2 histogram: bucket 0
+// holds passes under 16 us, bucket b those of 2^(b+3)..2^(b+4)-1 us, the last
+// one everything longer. Counts saturate instead of wrapping. Besides the
+// phases, PROF_PRESS_TO_TX measures from the contact edge of the panic button
+// to the panic frame being handed to the radio.
+//
+// All state is static (PROF_PHASES x 36 bytes). Without USE_PROFILER the
+// PROF_* macros expand to nothing and none of it is linked in.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "config.h"
+
+enum ProfPhase
+{
+    PROF_RX,           // draining the RX queue and handling the frames
+    PROF_BUTTONS,      // button sampling/debouncing and handling of all events
+    PROF_LONG_PRESS,   // long-press handling alone (naming mode)
+    PROF_PANIC_RENDER, // panic screen into the LCD shadow
+    PROF_IDLE_RENDER,  // idle screen into the LCD shadow
+    PROF_LCD_FLUSH,    // shadow changes out over I2C
+    PROF_TX,           // transmit queue service, incl. the SPI write of a frame
+    PROF_PRESS_TO_TX,  // panic button edge to the panic frame on air
+    PROF_PHASES
+};
+
+#define PROF_BUCKETS 16
+
+#ifdef USE_PROFILER
+#include "hal.h"
+
+void profRecord(uint8_t phase, uint32_t us);
+// Panic button contact closed at the given micros(); the next panic frame
+// sent closes the PROF_PRESS_TO_TX measurement
+void profPressAt(uint32_t us);
+// A panic frame has just gone to the radio
+void profPanicSent();
+
+// Count, p99 bucket bound, max and the histogram of every phase over serial
+void profReport();
+void profReset();
+
+#define PROF_BEGIN(t) uint32_t t = hal::micros()
+#define PROF_END(phase, t) profRecord(phase, hal::micros() - (t))
+#else
+#define PROF_BEGIN(t)
+#define PROF_END(phase, t)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,38 @@
+// Duplicate suppression and flood relaying of frames with sequence numbers.
+//
+// Panic, ACK and (with RELAY_MODE) press/release frames carry a sequence
+// number, so every copy of one transmission, direct or relayed, has the same
+// (origin node, type, seq). A ring of the last RELAY_CACHE_SLOTS such keys
+// tells the first copy from the rest; entries expire after
+// RELAY_CACHE_TTL_MS so a later retransmission by the origin is new again.
+// A panic's retries keep its seq, so they are told apart by the auth counter
+// with AUTH_FRAMES; without it a panic is only remembered for
+// RELAY_PANIC_TTL_MS, less than the first retry interval.
+//
+// With RELAY_MODE a first copy is queued again with its hop count increased,
+// after a random back-off slot, until RELAY_HOP_LIMIT hops.
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdint.h>
+#include "frame.h"
+
+// True for the first copy of a frame with a sequence number, false for a
+// duplicate heard within RELAY_CACHE_TTL_MS
+bool relayFirstSeen(const Frame &frame, uint32_t now);
+// Whether a copy of frame was seen within the TTL, without recording it
+bool relaySeen(const Frame &frame, uint32_t now);
+
+// Queue a copy one hop further; false past the hop limit or when the
+// transmit queue had no room
+bool relayForward(const Frame &frame);
+
+#ifdef STATS
+// Counters since boot
+uint16_t relayLookups();
+uint16_t relayDuplicates();
+uint16_t relayForwarded();
+#endif
+
+#endif // RELAY_H
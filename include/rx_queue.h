@@ -0,0 +1,36 @@
+// Receive ring buffer between the DIO0 RxDone interrupt and loop().
+//
+// Single producer (the radio interrupt) and single consumer (loop()), so the
+// 8-bit head/tail indices need no locking on AVR. A slot is filled in place
+// by the interrupt and only published by rxQueueCommit().
+
+#ifndef RX_QUEUE_H
+#define RX_QUEUE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "frame.h"
+
+#define RX_QUEUE_SLOTS 2 // power of two
+
+struct RxPacket
+{
+    uint8_t len;
+    int8_t snr;   // quarter dB, as reported by the SX127x
+    int16_t rssi; // dBm
+    uint8_t data[RADIO_FRAME_MAX];
+};
+
+// Producer side (interrupt context): the next free slot, or NULL when the
+// queue is full (the packet is counted as dropped)
+RxPacket *rxQueueReserve();
+void rxQueueCommit();
+
+// Consumer side: copies out the oldest packet, false when empty
+bool rxQueuePop(RxPacket &out);
+
+// Packets received / dropped because loop() fell behind, since boot
+uint16_t rxQueueReceived();
+uint16_t rxQueueDropped();
+
+#endif // RX_QUEUE_H
@@ -0,0 +1,52 @@
+// Cooperative scheduler for the periodic and one-shot jobs of loop().
+//
+// Tasks are indexed by a small ID chosen by the sketch, which describes them
+// in a table kept in flash; only the due times and the lateness are in RAM.
+// Each armed task has an absolute due time in millis(); schedRun() calls the
+// ones that are due and otherwise costs a single compare against the earliest
+// due time, which is cached. Periodic tasks are re-armed a period after their
+// previous deadline (no drift), or a period from now if they fell a whole
+// period behind. With STATS how late each task ran is kept for the serial
+// stats.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include "config.h" // SCHED_MAX_TASKS
+
+// now is the millis() value schedRun() was called with
+typedef void (*TaskFn)(uint32_t now);
+
+// A task: periodMs 0 makes it one-shot, a NULL fn leaves the ID unused
+struct SchedTask
+{
+    TaskFn fn;
+    uint16_t periodMs;
+};
+
+// Take the sketch's PROGMEM table, SCHED_MAX_TASKS entries indexed by task
+// ID; every task starts stopped
+void schedBegin(const SchedTask *table);
+
+// Arm (or re-arm) a task to run at dueMs / delayMs after now
+void schedAt(uint8_t id, uint32_t dueMs);
+void schedIn(uint8_t id, uint32_t now, uint32_t delayMs);
+void schedStop(uint8_t id);
+bool schedArmed(uint8_t id);
+
+// Run every task that is due at now, earliest deadline first
+void schedRun(uint32_t now);
+
+// True while no task is due yet at now, i.e. the CPU may sleep
+bool schedIdle(uint32_t now);
+// Time until the earliest armed task is due (possibly a little early after
+// a stop), 0 if one is due, 0xFFFFFFFF if none is armed
+uint32_t schedDueIn(uint32_t now);
+
+#ifdef STATS
+// Worst lateness of a task since boot, ms past its deadline
+uint16_t schedMaxLateMs(uint8_t id);
+#endif
+
+#endif // SCHEDULER_H
@@ -0,0 +1,92 @@
+// Host-side control of the simulated board behind the native HAL.
+//
+// Only available when building for the `native` env. A driver (the native
+// main, a test or a benchmark) owns the virtual clock: nothing advances time
+// except sim::advanceUs()/advanceMs() and hal::delay().
+
+#ifndef SIM_H
+#define SIM_H
+
+#ifndef ARDUINO
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sim
+{
+const uint8_t PIN_COUNT = 20;
+const uint16_t EEPROM_SIZE = 512; // ATmega168
+const uint8_t RADIO_MAX_PACKET = 255;
+
+// Restore power-on state: clock at 0, pins floating high, EEPROM erased,
+// blank LCD and an empty radio channel. Call before setup().
+void reset();
+
+// Virtual clock
+uint64_t nowUs();
+void advanceUs(uint64_t us);
+void advanceMs(uint32_t ms);
+
+// GPIO: drive an input pin as an external circuit would
+void setPin(uint8_t pin, uint8_t level);
+uint8_t pinLevel(uint8_t pin);
+// Convenience for the active-LOW buttons
+void setButton(uint8_t pin, bool pressed);
+
+// Buzzer: frequency currently driven on a pin (0 = silent)
+uint16_t toneFreq(uint8_t pin);
+
+// Seed for hal::entropy(), so runs are reproducible
+void setEntropySeed(uint32_t seed);
+
+// What hal::supplyMillivolts() reads (5000 after reset)
+void setSupplyMillivolts(uint16_t mv);
+
+// EEPROM backing store
+uint8_t *eeprom();
+
+// Serial output is echoed to stdout unless muted
+void setSerialEcho(bool echo);
+// Queue bytes for hal::serialRead(), as if typed into the serial monitor
+void serialInput(const char *text);
+
+// loop() passes that ended in hal::idle() or hal::powerDown() since reset,
+// and those of them in power-down
+uint32_t idleCount();
+uint32_t powerDownCount();
+
+// Virtual 16x2 LCD
+char lcdCell(uint8_t col, uint8_t row);
+// Copies one row (LCD_COLS chars + NUL) into out
+void lcdRow(uint8_t row, char *out);
+// Number of LCD commands and data writes issued since reset
+uint32_t lcdOps();
+
+// Loopback LoRa model
+// Deliver a packet to the radio as if it had been received over the air.
+// Runs the RxDone interrupt path immediately; ignored until the sketch has
+// put the radio into receive. While radioSleep()ing the packet is held, as
+// if its long preamble were on the air: the next radioSniff() detects it and
+// radioReceive() delivers it.
+void radioInject(const uint8_t *data, uint8_t len, int rssi, int8_t snrQuarterDb = 0);
+// Echo every transmitted packet back into the receive path
+void setRadioLoopback(bool loopback, int rssi);
+// Packets transmitted since reset, oldest first
+size_t radioSentCount();
+// Total time-on-air of the transmitted packets for the configured radio profile
+uint64_t radioAirtimeUs();
+// radioSend() calls refused because a transmit was still on air
+uint32_t radioRefusedCount();
+bool radioTakeSent(uint8_t *data, uint8_t *len);
+// Fail the next radioBegin() (module missing)
+void setRadioPresent(bool present);
+// Channel activity detection: radioSniff() also reports activity when
+// probe(ctx) says another unit's frame is on the air, e.g. in a multi-unit
+// channel model. The result is ready two symbols later. Kept across reset();
+// NULL (the default) is a quiet channel.
+void setCadProbe(bool (*probe)(void *ctx), void *ctx);
+}
+
+#endif // !ARDUINO
+
+#endif // SIM_H
@@ -0,0 +1,50 @@
+// Binary telemetry on the serial port (TELEMETRY in config.h).
+//
+// The port runs at TELEMETRY_BAUD and carries short records instead of text:
+//
+//     0xA5  type  len  payload[len]  crc
+//
+// crc is the CRC-8 (poly 0x07) of type, len and the payload; multi-byte
+// fields are little endian. A record is written only if the UART's TX buffer
+// has room for all of it, else it is dropped and counted (the next stats
+// record carries the count). Replies to serial commands still come out as
+// text in between; a reader resyncs on 0xA5 and the CRC.
+// tools/telemetry_decode.py turns the stream into CSV.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "config.h"
+
+#define TEL_SYNC 0xA5
+
+enum TelRecord
+{
+    TEL_EVENT = 1, // u32 ms, u8 event, u8 node, i8 rssi, u8 arg
+    TEL_FRAME = 2, // u32 ms, u8 frame type, u8 node, i8 rssi, i8 snr (dB/4), u8 len
+    TEL_STATS = 3  // u32 ms, u16 loop passes, u8 tx queue depth, u16 rx dropped,
+                   // u16 records dropped, u16 lcd stalls, u16 stack never used
+};
+
+// TEL_EVENT events: the JournalEvent codes (journal.h), plus
+enum
+{
+    TEL_EVENT_BUTTON_DOWN = 0x10, // arg: button index 0..4
+    TEL_EVENT_BUTTON_UP = 0x11
+};
+
+// TEL_FRAME type and node of a frame that did not decode
+#define TEL_FRAME_UNDECODED 0xFF
+
+#ifdef TELEMETRY
+void telEvent(uint8_t event, uint8_t node, int8_t rssi, uint8_t arg, uint32_t now);
+void telFrame(uint8_t type, uint8_t node, int8_t rssi, int8_t snr, uint8_t len, uint32_t now);
+// Count one loop() pass toward the next stats record
+void telLoopPass();
+// Stats since the last call; every TELEMETRY_PERIOD_MS
+void telStats(uint32_t now);
+uint16_t telDropped();
+#endif
+
+#endif // TELEMETRY_H
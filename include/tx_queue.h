@@ -0,0 +1,86 @@
+// Transmit queue in front of the LoRa radio.
+//
+// Every frame the sketch sends goes through here. A frame is handed to the
+// radio only once the previous non-blocking transmit has finished (TxDone),
+// highest priority first and in order within a priority. A frame whose
+// header (type/button and node) matches one still waiting is redundant (a
+// repeated hold press, beacon or panic resend) and is coalesced into it; one
+// with a newer panic sequence number takes the waiting copy's place instead.
+// ACKs to different nodes, and a press queued behind its own release, are
+// never merged.
+// When the queue is out of slots or bytes, lower-priority frames are
+// evicted to make room.
+// A frame can be held back for a while (relay back-off) without blocking
+// the frames queued after it. With LISTEN_BEFORE_TALK a CAD precedes every
+// transmit, and a busy channel puts the frames off by a random back-off.
+// With TDMA_BEACONS our beacon is time-stamped as it goes on air, or
+// dropped if it could no longer end inside its slot (beacon_slots.h). With
+// STATE_BEACONS a newer state snapshot is written into our waiting frame
+// that carries one, instead of queueing another frame, and a beacon with a
+// snapshot takes the place of a waiting one without.
+//
+// With STATS the time-on-air of everything sent is accounted per hour for
+// the duty cycle.
+
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "frame.h"
+
+// Frames waiting at once, and the bytes they share: the longest frame and
+// room for a few short ones beside it
+#define TX_QUEUE_SLOTS 4
+#define TX_QUEUE_BYTES (RADIO_FRAME_MAX + 16)
+
+enum TxPriority
+{
+    TX_PRIO_BEACON,
+    TX_PRIO_PRESS,
+    TX_PRIO_PANIC
+};
+
+// Priority of a frame of the given FrameType
+uint8_t txPriorityFor(uint8_t frameType);
+
+// Queue an encoded frame, to go on air no earlier than delayMs from now;
+// false if it was dropped (no room left besides frames of the same or
+// higher priority). A coalesced frame counts as accepted.
+bool txQueuePush(const uint8_t *data, uint8_t len, uint8_t prio, uint16_t delayMs = 0);
+
+#ifdef STATE_BEACONS
+// Give the waiting frame of state.node that carries the state TLV the state
+// of state (frameRestate) and at least prio; false if there is none. Counts
+// as coalesced.
+bool txQueueRestate(const Frame &state, uint8_t prio);
+#endif
+
+// Start the next transmit if the radio is free; call every loop() pass
+void txQueueService(uint32_t now);
+
+// Frames waiting for the radio
+uint8_t txQueueDepth();
+
+#ifdef STATS
+// Counters since boot (dropped includes slotted beacons that missed their slot)
+uint16_t txQueued();
+uint16_t txSent();
+uint16_t txCoalesced();
+uint16_t txDropped();
+#ifdef LISTEN_BEFORE_TALK
+// CADs run, CADs that found the channel busy, frames sent anyway after
+// LBT_MAX_TRIES busy CADs, and the back-off they caused
+uint16_t txLbtChecks();
+uint16_t txLbtBusy();
+uint16_t txLbtForced();
+uint32_t txLbtBackoffMs();
+#endif
+
+// Time-on-air over the last hour (sliding estimate from the current and the
+// previous clock hour), and as duty cycle in permille
+uint32_t txAirtimeLastHourMs(uint32_t now);
+uint16_t txDutyCyclePermille(uint32_t now);
+#endif
+
+#endif // TX_QUEUE_H
@@ -0,0 +1,329 @@
+#include "frame.h"
+
+#include <string.h>
+
+#define CODE_PRESS 0x00
+#define CODE_RELEASE 0x08
+#define CODE_PANIC 0x10
+#define CODE_BEACON 0x11
+#define CODE_BEEP 0x12
+#define CODE_ACK 0x13
+
+uint8_t frameNameLen(const char *name, uint8_t maxLen)
+{
+    uint8_t len = 0;
+    while (len < maxLen && name[len] != '\0')
+        ++len;
+    while (len > 0 && name[len - 1] == ' ')
+        --len;
+    return len;
+}
+
+uint16_t frameNameHash(const char *name, uint8_t len)
+{
+    uint16_t h = 5381;
+    for (uint8_t i = 0; i < len; ++i)
+        h = (uint16_t)(h * 33) ^ (uint8_t)name[i];
+    return h != 0 ? h : 1;
+}
+
+uint8_t frameNameCheck(uint16_t hash)
+{
+    if (hash == 0)
+        return 0;
+    uint8_t check = (uint8_t)(hash ^ hash >> 8);
+    return check != 0 ? check : 1;
+}
+
+uint8_t frameEncode(const Frame &frame, uint8_t *out)
+{
+    uint8_t code;
+    switch (frame.type)
+    {
+    case FRAME_PRESS:
+        code = CODE_PRESS | (frame.button & 0x07);
+        break;
+    case FRAME_RELEASE:
+        code = CODE_RELEASE | (frame.button & 0x07);
+        break;
+    case FRAME_PANIC:
+        code = CODE_PANIC;
+        break;
+    case FRAME_BEACON:
+        code = CODE_BEACON;
+        break;
+    case FRAME_ACK:
+        code = CODE_ACK;
+        break;
+    default:
+        code = CODE_BEEP;
+        break;
+    }
+
+    uint8_t pos = 0;
+    out[pos++] = 0x80 | (FRAME_VERSION << 5) | code;
+    out[pos++] = frame.node;
+    if (frame.type == FRAME_ACK)
+    {
+        out[pos++] = FRAME_TLV_ACK;
+        out[pos++] = 2;
+        out[pos++] = frame.target;
+        out[pos++] = frame.seq;
+    }
+    else if (frame.seq != 0)
+    {
+        out[pos++] = FRAME_TLV_SEQ;
+        out[pos++] = 1;
+        out[pos++] = frame.seq;
+    }
+    if (frame.hops != 0)
+    {
+        out[pos++] = FRAME_TLV_HOPS;
+        out[pos++] = 1;
+        out[pos++] = frame.hops;
+    }
+    if (frame.timeRoot != 0)
+    {
+        uint16_t ticks = frame.timeMs / FRAME_TIME_UNIT_MS;
+        if (ticks > 0x1FFF)
+            ticks = 0x1FFF;
+        uint8_t age = frame.timeAge > FRAME_TIME_MAX_AGE ? FRAME_TIME_MAX_AGE : frame.timeAge;
+        out[pos++] = FRAME_TLV_TIME;
+        out[pos++] = 3;
+        out[pos++] = frame.timeRoot;
+        out[pos++] = (uint8_t)(age << 5 | ticks >> 8);
+        out[pos++] = (uint8_t)ticks;
+    }
+    if (frame.state != 0)
+    {
+        out[pos++] = FRAME_TLV_STATE;
+        out[pos++] = 3;
+        out[pos++] = frame.state;
+        out[pos++] = frame.battery;
+        out[pos++] = frame.nameCheck;
+    }
+    if (frame.nameLen > 0)
+    {
+        uint8_t len = frame.nameLen > FRAME_NAME_MAX ? FRAME_NAME_MAX : frame.nameLen;
+        out[pos++] = FRAME_TLV_NAME;
+        out[pos++] = len;
+        memcpy(out + pos, frame.name, len);
+        pos += len;
+    }
+    if ((frame.type == FRAME_PANIC || frame.type == FRAME_ACK) && frame.authCounter != 0)
+    {
+        out[pos++] = FRAME_TLV_AUTH;
+        out[pos++] = 8;
+        for (int8_t shift = 24; shift >= 0; shift -= 8)
+            out[pos++] = (uint8_t)(frame.authCounter >> shift);
+        for (int8_t shift = 24; shift >= 0; shift -= 8)
+            out[pos++] = (uint8_t)(frame.authTag >> shift);
+    }
+    return pos;
+}
+
+// Old ASCII frames: "P<digit>[|name]", "R<digit>", "X|name", "TX", "B"
+static bool decodeLegacy(const uint8_t *buf, uint8_t len, Frame &frame)
+{
+    frame.node = FRAME_NODE_LEGACY;
+    uint8_t nameAt = 0;
+    if (len == 2 && buf[0] == 'T' && buf[1] == 'X')
+        frame.type = FRAME_BEACON;
+    else if (len == 1 && buf[0] == 'B')
+        frame.type = FRAME_BEEP;
+    else if (len >= 2 && (buf[0] == 'P' || buf[0] == 'R') && buf[1] >= '1' && buf[1] <= '8')
+    {
+        frame.type = buf[0] == 'P' ? FRAME_PRESS : FRAME_RELEASE;
+        frame.button = buf[1] - '1';
+        if (buf[0] == 'P' && len > 3 && buf[2] == '|')
+            nameAt = 3;
+    }
+    else if (len > 2 && buf[0] == 'X' && buf[1] == '|')
+    {
+        frame.type = FRAME_PANIC;
+        nameAt = 2;
+    }
+    else
+        return false;
+
+    if (nameAt != 0)
+    {
+        uint8_t nameLen = len - nameAt;
+        if (nameLen > FRAME_NAME_MAX)
+            nameLen = FRAME_NAME_MAX;
+        memcpy(frame.name, buf + nameAt, nameLen);
+        frame.nameLen = nameLen;
+    }
+    return true;
+}
+
+static uint32_t readBigEndian32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+bool frameDecode(const uint8_t *buf, uint8_t len, Frame &frame, bool acceptLegacy)
+{
+    frame.button = 0;
+    frame.seq = 0;
+    frame.target = 0;
+    frame.hops = 0;
+    frame.timeRoot = 0;
+    frame.timeAge = 0;
+    frame.timeMs = 0;
+    frame.authCounter = 0;
+    frame.authTag = 0;
+    frame.state = 0;
+    frame.battery = 0;
+    frame.nameCheck = 0;
+    frame.nameLen = 0;
+    if (len == 0)
+        return false;
+
+    if ((buf[0] & 0x80) == 0)
+        return acceptLegacy && decodeLegacy(buf, len, frame);
+
+    if (len < 2 || ((buf[0] >> 5) & 0x03) != FRAME_VERSION)
+        return false;
+
+    uint8_t code = buf[0] & 0x1F;
+    if (code < CODE_RELEASE)
+    {
+        frame.type = FRAME_PRESS;
+        frame.button = code - CODE_PRESS;
+    }
+    else if (code < CODE_PANIC)
+    {
+        frame.type = FRAME_RELEASE;
+        frame.button = code - CODE_RELEASE;
+    }
+    else if (code == CODE_PANIC)
+        frame.type = FRAME_PANIC;
+    else if (code == CODE_BEACON)
+        frame.type = FRAME_BEACON;
+    else if (code == CODE_BEEP)
+        frame.type = FRAME_BEEP;
+    else if (code == CODE_ACK)
+        frame.type = FRAME_ACK;
+    else
+        return false;
+    frame.node = buf[1];
+
+    // TLVs; unknown tags are skipped so newer senders stay readable
+    uint8_t pos = 2;
+    while (pos + 2 <= len)
+    {
+        uint8_t tag = buf[pos];
+        uint8_t tlvLen = buf[pos + 1];
+        pos += 2;
+        if (pos + tlvLen > len)
+            return false;
+        if (tag == FRAME_TLV_NAME)
+        {
+            uint8_t nameLen = tlvLen > FRAME_NAME_MAX ? FRAME_NAME_MAX : tlvLen;
+            memcpy(frame.name, buf + pos, nameLen);
+            frame.nameLen = nameLen;
+        }
+        else if (tag == FRAME_TLV_SEQ && tlvLen == 1)
+            frame.seq = buf[pos];
+        else if (tag == FRAME_TLV_ACK && tlvLen == 2)
+        {
+            frame.target = buf[pos];
+            frame.seq = buf[pos + 1];
+        }
+        else if (tag == FRAME_TLV_HOPS && tlvLen == 1)
+            frame.hops = buf[pos];
+        else if (tag == FRAME_TLV_TIME && tlvLen == 3 && buf[pos] != 0)
+        {
+            frame.timeRoot = buf[pos];
+            frame.timeAge = buf[pos + 1] >> 5;
+            frame.timeMs = (uint16_t)((buf[pos + 1] & 0x1F) << 8 | buf[pos + 2]) * FRAME_TIME_UNIT_MS;
+        }
+        else if (tag == FRAME_TLV_AUTH && tlvLen == 8 && (frame.type == FRAME_PANIC || frame.type == FRAME_ACK))
+        {
+            frame.authCounter = readBigEndian32(buf + pos);
+            frame.authTag = readBigEndian32(buf + pos + 4);
+        }
+        else if (tag == FRAME_TLV_STATE && tlvLen == 3)
+        {
+            frame.state = buf[pos] | FRAME_STATE_VALID;
+            frame.battery = buf[pos + 1];
+            frame.nameCheck = buf[pos + 2];
+        }
+        pos += tlvLen;
+    }
+    if (frame.type == FRAME_ACK && frame.target == 0)
+        return false;
+    return pos == len;
+}
+
+// Value of the state TLV in an encoded binary frame, NULL if none
+// Value of the first TLV tag of tlvLen bytes in an encoded frame, or NULL
+static const uint8_t *findTlv(const uint8_t *buf, uint8_t len, uint8_t tag, uint8_t tlvLen)
+{
+    if (len < 2 || (buf[0] & 0x80) == 0)
+        return NULL;
+    for (uint16_t pos = 2; pos + 2 <= len; pos += 2 + buf[pos + 1])
+    {
+        if (buf[pos] == tag && buf[pos + 1] == tlvLen && pos + 2 + tlvLen <= len)
+            return buf + pos + 2;
+    }
+    return NULL;
+}
+
+uint16_t frameSeqKey(const uint8_t *buf, uint8_t len)
+{
+    const uint8_t *value = findTlv(buf, len, FRAME_TLV_ACK, 2);
+    if (value != NULL)
+        return (uint16_t)value[0] << 8 | value[1];
+    value = findTlv(buf, len, FRAME_TLV_SEQ, 1);
+    return value != NULL ? value[0] : 0;
+}
+
+bool frameHasState(const uint8_t *buf, uint8_t len)
+{
+    return findTlv(buf, len, FRAME_TLV_STATE, 3) != NULL;
+}
+
+bool frameRestate(uint8_t *buf, uint8_t len, const Frame &from)
+{
+    uint8_t *value = (uint8_t *)findTlv(buf, len, FRAME_TLV_STATE, 3);
+    if (value == NULL)
+        return false;
+    value[0] = from.state | FRAME_STATE_VALID;
+    value[1] = from.battery;
+    value[2] = from.nameCheck;
+    return true;
+}
+
+#define ROR32(x, r) ((x) >> (r) | (x) << (32 - (r)))
+#define ROL32(x, r) ((x) << (r) | (x) >> (32 - (r)))
+
+void frameSpeckEncrypt(const uint8_t *key, uint32_t &x, uint32_t &y)
+{
+    // Key words k0, l0, l1, l2, little-endian as in the designers' test
+    // vectors; l[] is refilled round by round by the key schedule
+    uint32_t words[4];
+    for (uint8_t i = 0; i < 4; ++i)
+        words[i] = (uint32_t)key[4 * i] | (uint32_t)key[4 * i + 1] << 8 | (uint32_t)key[4 * i + 2] << 16 |
+                   (uint32_t)key[4 * i + 3] << 24;
+    uint32_t k = words[0];
+    uint32_t *l = words + 1;
+    for (uint8_t i = 0; i < 27; ++i)
+    {
+        x = (ROR32(x, 8) + y) ^ k;
+        y = ROL32(y, 3) ^ x;
+        uint32_t &li = l[i % 3];
+        li = (k + ROR32(li, 8)) ^ i;
+        k = ROL32(k, 3) ^ li;
+    }
+}
+
+uint32_t frameAuthTag(const Frame &frame, const uint8_t *key)
+{
+    uint8_t target = frame.type == FRAME_ACK ? frame.target : 0;
+    uint32_t x = (uint32_t)frame.type << 24 | (uint32_t)frame.node << 16 | (uint32_t)target << 8 | frame.seq;
+    uint32_t y = frame.authCounter;
+    frameSpeckEncrypt(key, x, y);
+    return x;
+}
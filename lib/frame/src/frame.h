@@ -0,0 +1,157 @@
+// Over-the-air frame format.
+//
+// Binary frames, version 1:
+//
+//   byte 0    0x80 | version << 5 | code
+//   byte 1    sender node ID (1..254)
+//   byte 2..  optional TLVs: tag, length, value
+//
+//   code 0x00-0x07  press of button n (0-based)
+//   code 0x08-0x0F  release of button n
+//   code 0x10       panic
+//   code 0x11       beacon (link test, no payload)
+//   code 0x12       remote beep
+//   code 0x13       acknowledgement (carries the ACK TLV)
+//
+//   TLV 0x01  name, up to FRAME_NAME_MAX characters
+//   TLV 0x02  sequence number (1 byte, non-zero) of a panic frame
+//   TLV 0x03  acknowledged node ID and sequence number (2 bytes)
+//   TLV 0x04  relay hops travelled so far (1 byte, absent on the original)
+//   TLV 0x05  slotted-beacon clock (3 bytes): root node ID the sender's
+//             clock follows, then 3 bits sync age (superframes since the
+//             root was heard, through any chain of units) and 13 bits
+//             position in the superframe in 8 ms units, big-endian
+//   TLV 0x06  authentication (8 bytes, panic and ACK frames only): the
+//             sender's frame counter and the tag, both 32 bits big-endian.
+//             The tag is one Speck64/128 block under a pre-shared key over
+//             type, sender, ACK target, sequence number and counter
+//             (frameAuthTag); hops and name are left out, so relays pass
+//             the TLV on as it is.
+//   TLV 0x07  state snapshot of the sender (3 bytes): flags (bit 7 set, bit 5
+//             own panic active, bits 0-4 buttons held), supply voltage in
+//             20 mV steps (0 unknown), and frameNameCheck() of its name
+//
+// Bit 7 of byte 0 is never set in the legacy ASCII frames ("P4|NAME", "R4",
+// "X|NAME", "TX", "B"), so both can share the channel while units migrate.
+//
+// At SF12/125 kHz/CR 4/8 with low data rate optimization a payload of up to
+// 2 bytes fits the minimum 8 payload symbols and 3..7 bytes cost one more
+// block of 8 (~262 ms). Steady-state frames are therefore kept at 2 bytes and
+// the name TLV is only attached while a name change is being announced.
+// Panic frames and ACKs carry a 3-byte TLV and cost one block more; they are
+// only repeated until acknowledged and then as slow keepalives. Slotted
+// beacons carry the time TLV and cost the same block; they go out once per
+// superframe instead of every few seconds. The auth TLV adds two more blocks
+// to panics and ACKs. The state TLV takes a 2-byte beacon to 7 bytes, one
+// block more; it is written into a frame still waiting to go out
+// (frameRestate) rather than sending a second frame.
+//
+// The codec is plain C++ with no Arduino or sketch configuration behind it,
+// so it builds for the host as well: unit tests in test/test_frame, a fuzz
+// target in tools/frame_fuzz.cpp and a benchmark in tools/frame_bench.cpp.
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+#define FRAME_VERSION 1
+// Longest frame without the auth TLV, and what the auth TLV adds
+#define FRAME_MAX_LEN 33
+#define FRAME_AUTH_TLV_LEN 10
+// Longest name carried; the sketch's NAME_MAX_LEN must match
+#define FRAME_NAME_MAX 12
+
+// Node ID carried by frames decoded from the legacy ASCII format
+#define FRAME_NODE_LEGACY 0
+
+// TLV tags
+#define FRAME_TLV_NAME 0x01
+#define FRAME_TLV_SEQ 0x02
+#define FRAME_TLV_ACK 0x03
+#define FRAME_TLV_HOPS 0x04
+#define FRAME_TLV_TIME 0x05
+#define FRAME_TLV_AUTH 0x06
+#define FRAME_TLV_STATE 0x07
+
+// Pre-shared key of the auth TLV
+#define FRAME_AUTH_KEY_LEN 16
+
+// Time TLV limits: positions up to 65.5 s in 8 ms steps, ages up to 7
+#define FRAME_TIME_UNIT_MS 8
+#define FRAME_TIME_MAX_MS (0x1FFF * FRAME_TIME_UNIT_MS)
+#define FRAME_TIME_MAX_AGE 7
+
+// Frame::state bits, the first byte of the state TLV
+#define FRAME_STATE_HELD 0x1F  // bit n: button n held
+#define FRAME_STATE_PANIC 0x20 // the sender's own panic is on
+#define FRAME_STATE_VALID 0x80 // always set, so a present TLV is never 0
+// Supply voltage steps of the state TLV
+#define FRAME_BATTERY_MV 20
+
+enum FrameType
+{
+    FRAME_PRESS,
+    FRAME_RELEASE,
+    FRAME_PANIC,
+    FRAME_BEACON,
+    FRAME_BEEP,
+    FRAME_ACK
+};
+
+struct Frame
+{
+    uint8_t type;
+    uint8_t node;
+    uint8_t button;  // FRAME_PRESS / FRAME_RELEASE only, 0-based
+    uint8_t seq;     // FRAME_PANIC / FRAME_ACK sequence number, 0 when absent
+    uint8_t target;  // FRAME_ACK only: node whose frame is acknowledged
+    uint8_t hops;    // times relayed, 0 from the originating node
+    uint8_t timeRoot; // time TLV: node the clock follows, 0 when absent
+    uint8_t timeAge;  // time TLV: superframes since the root was heard
+    uint16_t timeMs;  // time TLV: position in the superframe, 8 ms steps
+    uint32_t authCounter; // auth TLV (FRAME_PANIC / FRAME_ACK): 0 when absent
+    uint32_t authTag;
+    uint8_t state;     // state TLV: FRAME_STATE_* bits incl. VALID, 0 when absent
+    uint8_t battery;   // state TLV: supply in FRAME_BATTERY_MV steps, 0 unknown
+    uint8_t nameCheck; // state TLV: frameNameCheck() of the sender's name
+    uint8_t nameLen;  // 0 when the frame carries no name
+    char name[FRAME_NAME_MAX];
+};
+
+// Length of name with trailing spaces (the naming-mode filler) removed
+uint8_t frameNameLen(const char *name, uint8_t maxLen);
+
+// Hash of a name (len characters, len > 0), never 0; receivers keep it per node.
+// frameNameCheck() folds it into the state TLV's byte: 0 for no name (hash 0).
+uint16_t frameNameHash(const char *name, uint8_t len);
+uint8_t frameNameCheck(uint16_t hash);
+
+// Encode into out (at least FRAME_MAX_LEN bytes, FRAME_AUTH_TLV_LEN more for
+// a panic or ACK with authCounter set). Returns the frame length.
+uint8_t frameEncode(const Frame &frame, uint8_t *out);
+
+// Decode a received packet. Returns false for malformed frames, unknown
+// versions and, unless acceptLegacy, the old ASCII frames.
+bool frameDecode(const uint8_t *buf, uint8_t len, Frame &frame, bool acceptLegacy);
+
+// Sequence number of an encoded frame, with the ACK target in the high byte;
+// 0 for none (and for legacy frames). Cheaper than frameDecode() when only
+// that is wanted, e.g. to tell a repeat from a newer frame.
+uint16_t frameSeqKey(const uint8_t *buf, uint8_t len);
+
+// Whether an encoded frame carries the state TLV, and overwrite it with
+// state, battery and nameCheck of from (false if the frame carries none)
+bool frameHasState(const uint8_t *buf, uint8_t len);
+bool frameRestate(uint8_t *buf, uint8_t len, const Frame &from);
+
+// Tag of the auth TLV for frame.authCounter under key (FRAME_AUTH_KEY_LEN
+// bytes). Costs one Speck64/128 block: 27 rounds with the key schedule
+// computed alongside, so only the 16-byte key has to stay in RAM.
+uint32_t frameAuthTag(const Frame &frame, const uint8_t *key);
+// The Speck64/128 encryption of the block (x, y) behind it. The key bytes are
+// the key words k0, l0, l1, l2, each little-endian, as in the designers'
+// test vectors.
+void frameSpeckEncrypt(const uint8_t *key, uint32_t &x, uint32_t &y);
+
+#endif // FRAME_H
@@ -0,0 +1,16 @@
+#include "airtime.h"
+
+uint32_t loraTimeOnAirUs(uint8_t payloadLen, uint8_t sf, uint32_t bwHz, uint8_t cr4, uint16_t preambleLen)
+{
+    uint32_t symbolUs = ((uint32_t)1 << sf) * 1000000UL / bwHz;
+    uint8_t lowDataRate = symbolUs > 16000 ? 1 : 0;
+
+    int32_t bits = 8L * payloadLen - 4L * sf + 28;
+    int32_t bitsPerBlock = 4L * (sf - 2 * lowDataRate);
+    int32_t blocks = bits > 0 ? (bits + bitsPerBlock - 1) / bitsPerBlock : 0;
+    uint32_t payloadSymbols = 8 + (uint32_t)blocks * cr4;
+
+    // Preamble is preambleLen + 4.25 symbols; count in quarter symbols
+    uint32_t quarterSymbols = 4UL * preambleLen + 17 + 4 * payloadSymbols;
+    return quarterSymbols * (symbolUs / 4);
+}
@@ -0,0 +1,168 @@
+#include "auth.h"
+#include "hal.h"
+
+#ifdef AUTH_FRAMES
+
+static_assert(AUTH_KEY_LEN == FRAME_AUTH_KEY_LEN, "AUTH_KEY_LEN must match the codec's key");
+
+static uint8_t key[AUTH_KEY_LEN];
+static bool haveKey = false;
+static uint16_t boots = 0;      // top half of our counter
+static uint16_t sent = 0;       // bottom half: frames signed since boot
+static uint8_t bootsUnsaved = 0; // bytes of boots still to write
+static int8_t keyDigits = -1;   // hex digits taken so far, -1 outside key entry
+
+static uint16_t badTags = 0;
+static uint16_t replays = 0;
+
+static void loadKey()
+{
+    haveKey = false;
+    for (uint8_t i = 0; i < AUTH_KEY_LEN; ++i)
+    {
+        key[i] = hal::eepromRead(AUTH_KEY_EEPROM_ADDR + i);
+        if (key[i] != 0xFF)
+            haveKey = true;
+    }
+}
+
+// Take the next boot count; the old one stays spent even if this one
+// never reaches the EEPROM
+static void nextBoot()
+{
+    ++boots;
+    sent = 0;
+    bootsUnsaved = 2;
+}
+
+void authBegin()
+{
+    loadKey();
+    boots = hal::eepromRead(AUTH_BOOTS_EEPROM_ADDR) | (uint16_t)hal::eepromRead(AUTH_BOOTS_EEPROM_ADDR + 1) << 8;
+    nextBoot();
+}
+
+void authService()
+{
+    if (bootsUnsaved == 0 || !hal::eepromReady())
+        return;
+    uint8_t i = 2 - bootsUnsaved;
+    hal::eepromUpdate(AUTH_BOOTS_EEPROM_ADDR + i, (uint8_t)(boots >> (8 * i)));
+    --bootsUnsaved;
+}
+
+bool authHasKey()
+{
+    return haveKey;
+}
+
+void authSign(Frame &f)
+{
+    f.authCounter = 0;
+    if (!haveKey)
+        return;
+    if (++sent == 0)
+    {
+        // 65535 frames this boot: carry on as the next boot
+        nextBoot();
+        sent = 1;
+    }
+    f.authCounter = (uint32_t)boots << 16 | sent;
+    f.authTag = frameAuthTag(f, key);
+}
+
+bool authCheck(const Frame &f, const NodeEntry *node, bool copy)
+{
+    if (!haveKey || f.authCounter == 0 || frameAuthTag(f, key) != f.authTag)
+    {
+        ++badTags;
+        return false;
+    }
+    if (node != NULL && f.authCounter == node->authCounter && copy)
+        return true;
+    if (node != NULL && f.authCounter <= node->authCounter)
+    {
+        ++replays;
+        return false;
+    }
+    return true;
+}
+
+void authAccepted(const Frame &f, NodeEntry &node)
+{
+    node.authCounter = f.authCounter;
+}
+
+static int8_t hexValue(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool authKeyInput(int c)
+{
+    if (keyDigits < 0)
+    {
+        if (c != 'K')
+            return false;
+        keyDigits = 0;
+        return true;
+    }
+    if (c < 0)
+        return true; // nothing received yet
+
+    // The digits go straight into the key in use; an aborted entry reloads it
+    int8_t value = hexValue(c);
+    if (value < 0)
+    {
+        keyDigits = -1;
+        loadKey();
+        hal::serialPrintln_P(PSTR("key unchanged"));
+        return true;
+    }
+    uint8_t &b = key[keyDigits / 2];
+    b = (keyDigits & 1) ? (uint8_t)(b << 4 | value) : (uint8_t)value;
+    if (++keyDigits < AUTH_KEY_LEN * 2)
+        return true;
+
+    keyDigits = -1;
+    for (uint8_t i = 0; i < AUTH_KEY_LEN; ++i)
+        hal::eepromUpdate(AUTH_KEY_EEPROM_ADDR + i, key[i]);
+    loadKey();
+    hal::serialPrintln_P(haveKey ? PSTR("key set") : PSTR("key cleared"));
+    return true;
+}
+
+uint32_t authBenchMicros()
+{
+    Frame f;
+    f.type = FRAME_PANIC;
+    f.node = 1;
+    f.target = 0;
+    f.seq = 1;
+    volatile uint32_t sink = 0;
+    uint32_t start = hal::micros();
+    for (uint8_t i = 1; i <= AUTH_BENCH_TAGS; ++i)
+    {
+        f.authCounter = i;
+        sink = sink ^ frameAuthTag(f, key);
+    }
+    return hal::micros() - start;
+}
+
+uint16_t authBadTags()
+{
+    return badTags;
+}
+
+uint16_t authReplays()
+{
+    return replays;
+}
+
+#endif // AUTH_FRAMES
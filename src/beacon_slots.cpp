@@ -0,0 +1,252 @@
+#include "beacon_slots.h"
+#include "airtime.h"
+#include "hal.h"
+
+#include <string.h>
+
+#ifdef TDMA_BEACONS
+
+static_assert(TDMA_SLOTS >= 2 && TDMA_SLOTS <= 32, "TDMA_SLOTS must be 2..32");
+static_assert(TDMA_SUPERFRAME_MS <= FRAME_TIME_MAX_MS, "superframe too long for the time TLV");
+static_assert(TDMA_SYNC_MAX_AGE <= FRAME_TIME_MAX_AGE, "TDMA_SYNC_MAX_AGE too high for the time TLV");
+
+// A slot counts as taken until no beacon was heard in it for this many
+// superframes, as a single beacon is easily lost
+#define HEARD_HISTORY 4
+
+// A CAD takes two symbols
+#define CAD_MS (2000UL * (1UL << RADIO.spreadingFactor) / RADIO.bandwidthHz)
+
+static uint8_t self = 0;
+static uint8_t ownSlot = 1;
+static uint8_t root = 0;
+static uint8_t age = 0;
+static bool listening = true;     // first superframe after boot
+static uint32_t superframeAt = 0; // local time the current superframe began
+// Slots other units' beacons were heard in, this superframe first
+static uint32_t heard[HEARD_HISTORY];
+
+static uint16_t resyncs = 0;
+static uint16_t moves = 0;
+static uint16_t missed = 0;
+static int16_t lastCorrectionMs = 0;
+
+static uint32_t airtimeMs(uint8_t len)
+{
+    return loraTimeOnAirUs(len, RADIO.spreadingFactor, RADIO.bandwidthHz, RADIO.codingRate,
+                           LORA_PREAMBLE_LEN) / 1000;
+}
+
+// Slots a beacon of len bytes needs from the start of its own: the jitter,
+// the CAD and its time on air
+static uint8_t slotsFor(uint8_t len)
+{
+    return (TDMA_JITTER_MS + CAD_MS + airtimeMs(len) + TDMA_SLOT_MS - 1) / TDMA_SLOT_MS;
+}
+
+static bool slotBusy(uint8_t slot)
+{
+    uint32_t any = 0;
+    for (uint8_t i = 0; i < HEARD_HISTORY; ++i)
+        any |= heard[i];
+    return (any >> slot) & 1;
+}
+
+// Move on to the superframe now is in; the age of the root's clock grows
+// with every superframe until a beacon refreshes it
+static void roll(uint32_t now)
+{
+    while ((int32_t)(now - superframeAt) >= (int32_t)TDMA_SUPERFRAME_MS)
+    {
+        superframeAt += TDMA_SUPERFRAME_MS;
+        memmove(&heard[1], &heard[0], (HEARD_HISTORY - 1) * sizeof(heard[0]));
+        heard[0] = 0;
+        listening = false;
+        if (root != self && ++age > TDMA_SYNC_MAX_AGE)
+        {
+            // Root gone quiet: keep the clock, but as our own
+            root = self;
+            age = 0;
+            ++resyncs;
+        }
+    }
+}
+
+// Position of now in the superframe, ms
+static uint32_t position(uint32_t now)
+{
+    roll(now);
+    int32_t pos = (int32_t)(now - superframeAt);
+    return pos < 0 ? pos + TDMA_SUPERFRAME_MS : pos;
+}
+
+void slotsBegin(uint8_t nodeId, uint32_t now)
+{
+    self = nodeId;
+    root = nodeId;
+    age = 0;
+    ownSlot = 1 + nodeId % (TDMA_SLOTS - 1);
+    listening = true;
+    superframeAt = now;
+    memset(heard, 0, sizeof(heard));
+}
+
+uint32_t slotsNextBeaconAt(uint32_t now)
+{
+    roll(now);
+    uint32_t at = superframeAt + (uint32_t)ownSlot * TDMA_SLOT_MS;
+    if (listening || (int32_t)(now - at) >= 0)
+        at += TDMA_SUPERFRAME_MS;
+    return at + hal::entropy() % TDMA_JITTER_MS;
+}
+
+bool slotsRoomForName(uint8_t nameLen)
+{
+    // Header, time TLV and name TLV
+    uint8_t need = slotsFor(2 + 5 + 2 + nameLen);
+    for (uint8_t i = 1; i < need; ++i)
+    {
+        if (slotBusy((ownSlot + i) % TDMA_SLOTS))
+            return false;
+    }
+    return true;
+}
+
+void slotsSetTime(Frame &f, uint32_t now)
+{
+    f.timeMs = (uint16_t)position(now);
+    f.timeRoot = root;
+    f.timeAge = age;
+}
+
+bool slotsStamp(uint8_t *data, uint8_t len, uint32_t now)
+{
+    Frame f;
+    if (!frameDecode(data, len, f, false) || f.type != FRAME_BEACON || f.node != self || f.timeRoot == 0)
+        return true;
+
+    uint32_t pos = position(now);
+    uint32_t slotStart = (uint32_t)ownSlot * TDMA_SLOT_MS;
+    if (pos < slotStart || pos + airtimeMs(len) > slotStart + (uint32_t)slotsFor(len) * TDMA_SLOT_MS)
+    {
+        ++missed;
+        return false;
+    }
+    slotsSetTime(f, now);
+    frameEncode(f, data);
+    return true;
+}
+
+bool slotsHeard(const Frame &f, uint8_t len, uint32_t now)
+{
+    if (f.timeRoot == 0 || f.hops != 0)
+        return false;
+
+    // Where the sender's superframe is now: its position when it started
+    // sending (rounded down to 8 ms, so take the middle) plus time on air
+    uint32_t toa = airtimeMs(len);
+    uint32_t theirs = (f.timeMs + FRAME_TIME_UNIT_MS / 2 + toa) % TDMA_SUPERFRAME_MS;
+    uint32_t ours = position(now);
+    bool changed = false;
+
+    // Follow a lower root, or our root over a chain no older than ours.
+    // As a root ourselves (and straight after boot), take over the phase of
+    // any other clock but keep our ID: units on that clock could not decode
+    // our beacons while they landed in their slots, and once they do they
+    // switch to us without a jump.
+    uint8_t theirAge = f.timeAge + 1;
+    bool follow = theirAge <= TDMA_SYNC_MAX_AGE &&
+                  (f.timeRoot < root || (f.timeRoot == root && root != self && theirAge <= age));
+    if (follow || listening || (root == self && f.timeRoot != self))
+    {
+        int32_t correction = (int32_t)(theirs - ours);
+        if (correction > (int32_t)TDMA_SUPERFRAME_MS / 2)
+            correction -= TDMA_SUPERFRAME_MS;
+        else if (correction < -(int32_t)TDMA_SUPERFRAME_MS / 2)
+            correction += TDMA_SUPERFRAME_MS;
+        lastCorrectionMs = (int16_t)correction;
+        if (correction != 0)
+        {
+            superframeAt = now - theirs;
+            changed = true;
+        }
+        if (follow)
+        {
+            if (f.timeRoot != root)
+                ++resyncs;
+            root = f.timeRoot;
+            age = theirAge;
+        }
+        listening = false;
+    }
+    if (f.timeRoot != root)
+        return changed; // on another clock, its slots say nothing about ours
+
+    // Slots its beacon takes up; if one is ours, two of us share it
+    uint8_t slot = f.timeMs / TDMA_SLOT_MS;
+    uint8_t spans = (f.timeMs % TDMA_SLOT_MS + toa + TDMA_SLOT_MS - 1) / TDMA_SLOT_MS;
+    for (uint8_t i = 0; i < spans; ++i)
+        heard[0] |= 1UL << ((slot + i) % TDMA_SLOTS);
+    if (slot == ownSlot)
+    {
+        // Move to a random slot nobody was heard in lately
+        uint8_t free = 0;
+        for (uint8_t s = 1; s < TDMA_SLOTS; ++s)
+        {
+            if (!slotBusy(s))
+                ++free;
+        }
+        if (free > 0)
+        {
+            uint8_t pick = hal::entropy() % free;
+            for (uint8_t s = 1; s < TDMA_SLOTS; ++s)
+            {
+                if (!slotBusy(s) && pick-- == 0)
+                {
+                    ownSlot = s;
+                    break;
+                }
+            }
+            ++moves;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+uint8_t slotsOwn()
+{
+    return ownSlot;
+}
+
+uint8_t slotsRoot()
+{
+    return root;
+}
+
+uint8_t slotsAge()
+{
+    return age;
+}
+
+uint16_t slotsResyncs()
+{
+    return resyncs;
+}
+
+uint16_t slotsMoves()
+{
+    return moves;
+}
+
+uint16_t slotsMissed()
+{
+    return missed;
+}
+
+int16_t slotsLastCorrectionMs()
+{
+    return lastCorrectionMs;
+}
+
+#endif // TDMA_BEACONS
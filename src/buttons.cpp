@@ -0,0 +1,97 @@
+#include "buttons.h"
+#include "hal.h"
+
+static uint8_t state = 0;                     // debounced, bit set = held
+static uint8_t ct0 = 0xFF;                    // vertical counter, low bits
+static uint8_t ct1 = 0xFF;                    // vertical counter, high bits
+static uint8_t edgeSeen = 0;                  // bits with an unresolved timestamped edge
+static uint8_t longDone = 0;                  // long press already reported
+static uint16_t edgeAt[BUTTON_COUNT];         // first edge of the current bounce
+static uint16_t pressAt[BUTTON_COUNT];        // when the held buttons went down
+static uint8_t lastRaw = 0;
+static uint32_t lastSample = 0;
+
+void buttonsBegin()
+{
+    lastRaw = hal::readButtons();
+    hal::buttonEdgesBegin();
+}
+
+uint8_t buttonsHeld()
+{
+    return state;
+}
+
+bool buttonsIdle()
+{
+    return state == 0 && edgeSeen == 0 && hal::readButtons() == 0;
+}
+
+uint8_t buttonsPoll(uint32_t now, ButtonEvent *out)
+{
+    // Timestamp the first edge of each bounce burst
+    hal::ButtonEdge edge;
+    while (hal::buttonEdgePop(edge))
+    {
+        uint8_t fresh = (edge.mask ^ lastRaw) & ~edgeSeen;
+        for (uint8_t b = 0; b < BUTTON_COUNT; ++b)
+        {
+            if (fresh & (1 << b))
+                edgeAt[b] = edge.atMs;
+        }
+        edgeSeen |= fresh;
+        lastRaw = edge.mask;
+    }
+
+    uint8_t n = 0;
+    uint8_t toggled = 0;
+    if (now - lastSample >= BUTTON_SAMPLE_MS)
+    {
+        lastSample = now;
+        uint8_t sample = hal::readButtons();
+
+        // Count each bit that differs from the debounced state; any sample
+        // that agrees resets that bit's counter
+        uint8_t delta = state ^ sample;
+        ct0 = ~(ct0 & delta);
+        ct1 = ct0 ^ (ct1 & delta);
+        toggled = delta & ct0 & ct1;
+        state ^= toggled;
+
+        for (uint8_t b = 0; b < BUTTON_COUNT; ++b)
+        {
+            uint8_t bit = 1 << b;
+            if (!(toggled & bit))
+                continue;
+            ButtonEvent &ev = out[n++];
+            ev.button = b;
+            ev.atMs = (edgeSeen & bit) ? edgeAt[b] : (uint16_t)now;
+            if (state & bit)
+            {
+                ev.type = BUTTON_PRESS;
+                pressAt[b] = ev.atMs;
+                longDone &= ~bit;
+            }
+            else
+                ev.type = BUTTON_RELEASE;
+        }
+        // Edges are resolved once the raw level matches the debounced state
+        edgeSeen &= state ^ sample;
+    }
+
+    // Long presses, for buttons that did not change this pass
+    uint8_t candidates = state & ~longDone & ~toggled;
+    for (uint8_t b = 0; candidates != 0 && b < BUTTON_COUNT; ++b)
+    {
+        uint8_t bit = 1 << b;
+        if ((candidates & bit) && (uint16_t)((uint16_t)now - pressAt[b]) >= LONG_PRESS_MS)
+        {
+            longDone |= bit;
+            ButtonEvent &ev = out[n++];
+            ev.type = BUTTON_LONG_PRESS;
+            ev.button = b;
+            ev.atMs = (uint16_t)now;
+        }
+    }
+    return n;
+}
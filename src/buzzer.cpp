@@ -0,0 +1,129 @@
+#include "buzzer.h"
+#include "config.h"
+#include "hal.h"
+
+// One step of a pattern; a step with ms 0 ends it
+struct BuzzerStep
+{
+    uint16_t freqHz; // 0 for silence
+    uint16_t ms;
+};
+
+#define SIREN_STEP_MS 100 // panic siren on/off cadence
+#define CHIRP_FREQ_HZ (BEEP_FREQ_HZ * 2)
+
+static const BuzzerStep beepSteps[] PROGMEM = {{BEEP_FREQ_HZ, BEEP_DURATION_MS}, {0, 0}};
+static const BuzzerStep sirenSteps[] PROGMEM = {{BEEP_FREQ_HZ, SIREN_STEP_MS}, {0, SIREN_STEP_MS}, {0, 0}};
+static const BuzzerStep chirpSteps[] PROGMEM = {{CHIRP_FREQ_HZ, 40}, {0, 40}, {CHIRP_FREQ_HZ, 80}, {0, 0}};
+
+// Requests from loop(): single bytes, so the tick never sees half of one.
+// Each buzzerPlay() bumps playRequests; the tick plays playId when the count
+// differs from the one it served last.
+static volatile uint8_t playId = BUZZER_SILENT;
+static volatile uint8_t playRequests = 0;
+static volatile uint8_t loopId = BUZZER_SILENT;
+static volatile bool sounding = false;
+
+// Owned by the tick; the first two are read by buzzerSounding()
+static volatile uint8_t playServed = 0;
+static volatile uint8_t current = BUZZER_SILENT;
+static bool oneShot = false;
+static const BuzzerStep *step = NULL; // NULL while silent
+static uint16_t stepLeftMs = 0;
+static uint16_t tickUs = 0; // time since the last whole ms
+
+static const BuzzerStep *patternSteps(uint8_t pattern)
+{
+    switch (pattern)
+    {
+    case BUZZER_BEEP:
+        return beepSteps;
+    case BUZZER_SIREN:
+        return sirenSteps;
+    case BUZZER_CHIRP:
+        return chirpSteps;
+    default:
+        return NULL;
+    }
+}
+
+static void startStep(const BuzzerStep *s)
+{
+    step = s;
+    stepLeftMs = pgm_read_word(&s->ms);
+    hal::buzzerTone(pgm_read_word(&s->freqHz));
+}
+
+static void startPattern(uint8_t pattern, bool once)
+{
+    current = pattern;
+    oneShot = once;
+    const BuzzerStep *steps = patternSteps(pattern);
+    sounding = steps != NULL;
+    if (steps != NULL)
+        startStep(steps);
+    else
+    {
+        step = NULL;
+        hal::buzzerTone(0);
+    }
+}
+
+// Timer interrupt, every HAL_TICK_US
+static void buzzerTick()
+{
+    if (playRequests != playServed)
+    {
+        playServed = playRequests;
+        startPattern(playId, true);
+        tickUs = 0;
+        return;
+    }
+    if (!oneShot && current != loopId)
+    {
+        startPattern(loopId, false);
+        tickUs = 0;
+        return;
+    }
+
+    if (step == NULL)
+        return;
+    for (tickUs += HAL_TICK_US; step != NULL && tickUs >= 1000; tickUs -= 1000)
+    {
+        if (--stepLeftMs != 0)
+            continue;
+        const BuzzerStep *next = step + 1;
+        if (pgm_read_word(&next->ms) != 0)
+            startStep(next);
+        else if (oneShot)
+            startPattern(loopId, false); // back to the background
+        else
+            startStep(patternSteps(current));
+    }
+}
+
+void buzzerBegin()
+{
+    hal::buzzerTone(0);
+    hal::tickBegin(buzzerTick);
+}
+
+void buzzerPlay(uint8_t pattern)
+{
+    if (!BUZZER_ENABLED)
+        return;
+    playId = pattern;
+    ++playRequests;
+}
+
+void buzzerLoop(uint8_t pattern)
+{
+    if (!BUZZER_ENABLED)
+        return;
+    loopId = pattern;
+}
+
+bool buzzerSounding()
+{
+    return sounding || playRequests != playServed || loopId != current;
+}
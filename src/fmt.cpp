@@ -0,0 +1,20 @@
+#include "fmt.h"
+
+uint8_t fmtUnsigned(char *out, uint16_t value, uint8_t width)
+{
+    // 16-bit division: much cheaper than 32-bit on AVR
+    char digits[5];
+    uint8_t n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    uint8_t len = 0;
+    while (len + n < width)
+        out[len++] = ' ';
+    while (n > 0)
+        out[len++] = digits[--n];
+    return len;
+}
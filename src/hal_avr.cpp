@@ -0,0 +1,650 @@
+// HAL backend for the board: forwards to the Arduino core and libraries.
+
+#ifdef ARDUINO
+
+#include "hal.h"
+#include "log.h"
+#include "rx_queue.h"
+#include <EEPROM.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include <util/twi.h>
+
+#ifdef USE_LORA
+#include <SPI.h>
+#include <LoRa.h>
+#endif
+
+static uint8_t lcdInitStep = 0;
+#ifdef USE_LORA
+static volatile bool txBusy = false;
+static volatile int8_t sniffResult = 0;
+#endif
+
+// The core's serial ring buffer holds one byte less than its size
+static_assert(SERIAL_TX_BUFFER_SIZE - 1 >= LOG_LINE_BYTES,
+              "a log line must fit in the serial TX buffer");
+
+// buzzerTone() drives Timer1's OC1B output
+static_assert(PINS.buzzer == 10, "the buzzer must be on D10 (OC1B)");
+
+static void (*tickFn)() = NULL;
+
+// Timer0 also counts millis() on overflow; compare B halfway through each
+// of its 1.024 ms periods drives the tick
+ISR(TIMER0_COMPB_vect)
+{
+    tickFn();
+}
+
+// Set by the watchdog interrupt that ends a powerDown()
+static volatile bool wdtFired = false;
+// Arduino core (wiring.c): millis() counter, advanced by Timer0
+extern volatile unsigned long timer0_millis;
+
+ISR(WDT_vect)
+{
+    wdtFired = true;
+}
+
+// Button edges captured by the pin-change interrupts
+#define EDGE_QUEUE_SLOTS 4 // power of two
+static hal::ButtonEdge edgeQueue[EDGE_QUEUE_SLOTS];
+static volatile uint8_t edgeHead = 0;
+static volatile uint8_t edgeTail = 0;
+static uint8_t edgeLastMask = 0;
+
+static void recordButtonEdge()
+{
+    uint8_t mask = hal::readButtons();
+    if (mask == edgeLastMask)
+        return; // another pin on the same port
+    edgeLastMask = mask;
+    if ((uint8_t)(edgeHead - edgeTail) >= EDGE_QUEUE_SLOTS)
+        return; // full: the sampled debounce still sees the change, only the timestamp is lost
+    hal::ButtonEdge &edge = edgeQueue[edgeHead & (EDGE_QUEUE_SLOTS - 1)];
+    edge.atMs = (uint16_t)millis();
+    edge.mask = mask;
+    ++edgeHead;
+}
+
+ISR(PCINT0_vect)
+{
+    recordButtonEdge();
+}
+
+ISR(PCINT2_vect)
+{
+    recordButtonEdge();
+}
+
+#ifdef USE_LORA
+// DIO0 RxDone, interrupt context. arduino-LoRa registers DIO0 with
+// SPI.usingInterrupt(), so loop()-side SPI transactions cannot interleave.
+static void onRadioReceive(int packetSize)
+{
+    RxPacket *slot = rxQueueReserve();
+    if (slot == NULL || packetSize > RADIO_FRAME_MAX)
+        return; // full, or too long to be one of our frames
+
+    uint8_t len = 0;
+    while (LoRa.available() && len < RADIO_FRAME_MAX)
+        slot->data[len++] = (uint8_t)LoRa.read();
+    slot->len = len;
+    slot->rssi = LoRa.packetRssi();
+    slot->snr = (int8_t)(LoRa.packetSnr() * 4);
+    rxQueueCommit();
+}
+
+// DIO0 TxDone, interrupt context: the radio drops to standby after a
+// transmit, put it back into continuous receive
+static void onRadioTxDone()
+{
+    txBusy = false;
+    LoRa.receive();
+}
+
+// DIO0 CadDone, interrupt context; the radio is in standby now
+static void onRadioCadDone(boolean detected)
+{
+    sniffResult = detected ? 1 : 0;
+}
+#endif
+
+// LCD: an HD44780 behind a PCF8574, written by the TWI interrupt. The
+// sketch's LCD calls only queue operations; the interrupt turns each into
+// PCF8574 port writes and streams them in one I2C transaction for as long as
+// the queue has more. Every nibble is three writes (data, E high, E low).
+// At 400 kHz a write takes 22.5 us, so the next E pulse still comes after the
+// 37 us a command needs.
+#ifdef LCD_I2C_FAST
+#define LCD_I2C_HZ 400000UL
+#else
+#define LCD_I2C_HZ 100000UL
+#endif
+#define LCD_QUEUE_MASK (LCD_QUEUE_SLOTS - 1)
+#if LCD_QUEUE_SLOTS & LCD_QUEUE_MASK
+#error "LCD_QUEUE_SLOTS must be a power of two"
+#endif
+
+// PCF8574 port bits on the usual backpack, data on P4-P7
+#define PCF_RS 0x01
+#define PCF_EN 0x04
+#define PCF_BACKLIGHT 0x08
+
+// HD44780 instructions used here
+#define HD_CLEAR 0x01
+#define HD_ENTRY_LEFT 0x06    // entry mode: increment, no shift
+#define HD_DISPLAY_ON 0x0C    // display on, cursor and blink off
+#define HD_FUNCTION_4BIT 0x28 // 4-bit, two lines, 5x8 dots
+#define HD_SET_DDRAM 0x80
+// Clear and home take 1.52 ms; the bus idles with E low for that long
+#define HD_CLEAR_WAIT_WRITES (uint8_t)(1600UL * (LCD_I2C_HZ / 1000) / 9000 + 1)
+
+enum
+{
+    LCDQ_COMMAND,   // instruction byte, two nibbles with RS low
+    LCDQ_DATA,      // character, two nibbles with RS high
+    LCDQ_NIBBLE,    // high nibble only (power-on sequence)
+    LCDQ_WAIT,      // value port writes without E
+    LCDQ_BACKLIGHT  // value is PCF_BACKLIGHT or 0
+};
+struct LcdOp
+{
+    uint8_t kind;
+    uint8_t value;
+};
+static LcdOp lcdQueue[LCD_QUEUE_SLOTS];
+static volatile uint8_t lcdHead = 0;  // written by the sketch
+static volatile uint8_t lcdTail = 0;  // written by the interrupt
+static uint8_t lcdPhase = 0;          // port write within lcdQueue[lcdTail]
+static uint8_t lcdLight = 0;          // backlight bit of every port write
+static volatile bool twiBusy = false; // a transaction is in progress
+#ifdef STATS
+static volatile uint32_t lcdBytes = 0;
+static uint8_t lcdDepthMax = 0;
+static uint16_t lcdStalls = 0;
+static uint16_t lcdNacks = 0;
+#endif
+
+// Next PCF8574 port value, or false once the queue is empty
+static bool lcdNextWrite(uint8_t &out)
+{
+    if (lcdTail == lcdHead)
+        return false;
+    const LcdOp &op = lcdQueue[lcdTail & LCD_QUEUE_MASK];
+    uint8_t writes;
+    switch (op.kind)
+    {
+    case LCDQ_WAIT:
+        out = lcdLight;
+        writes = op.value;
+        break;
+    case LCDQ_BACKLIGHT:
+        lcdLight = op.value;
+        out = lcdLight;
+        writes = 1;
+        break;
+    default:
+    {
+        uint8_t nibble = lcdPhase < 3 ? op.value & 0xF0 : (uint8_t)(op.value << 4);
+        out = nibble | lcdLight | (op.kind == LCDQ_DATA ? PCF_RS : 0) | (lcdPhase % 3 == 1 ? PCF_EN : 0);
+        writes = op.kind == LCDQ_NIBBLE ? 3 : 6;
+        break;
+    }
+    }
+    if (++lcdPhase >= writes)
+    {
+        lcdPhase = 0;
+        lcdTail = lcdTail + 1;
+    }
+    return true;
+}
+
+ISR(TWI_vect)
+{
+    uint8_t next;
+    switch (TW_STATUS)
+    {
+    case TW_START:
+    case TW_REP_START:
+        TWDR = (I2C_LCD_ADDR << 1) | TW_WRITE;
+        break;
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if (lcdNextWrite(next))
+        {
+            TWDR = next;
+            break;
+        }
+        TWCR = _BV(TWEN) | _BV(TWSTO) | _BV(TWINT);
+        twiBusy = false;
+        return;
+    default:
+        // No backpack answering (or a bus error): drop what is queued rather
+        // than retry forever from the interrupt
+#ifdef STATS
+        ++lcdNacks;
+#endif
+        lcdTail = lcdHead;
+        lcdPhase = 0;
+        TWCR = _BV(TWEN) | _BV(TWSTO) | _BV(TWINT);
+        twiBusy = false;
+        return;
+    }
+#ifdef STATS
+    ++lcdBytes;
+#endif
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT);
+}
+
+// Queue one operation, waiting only while the queue is full (a stall)
+static void lcdPush(uint8_t kind, uint8_t value)
+{
+    if ((uint8_t)(lcdHead - lcdTail) >= LCD_QUEUE_SLOTS)
+    {
+#ifdef STATS
+        ++lcdStalls;
+#endif
+        while ((uint8_t)(lcdHead - lcdTail) >= LCD_QUEUE_SLOTS)
+        {
+        }
+    }
+    LcdOp &op = lcdQueue[lcdHead & LCD_QUEUE_MASK];
+    op.kind = kind;
+    op.value = value;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        lcdHead = lcdHead + 1;
+#ifdef STATS
+        uint8_t depth = lcdHead - lcdTail;
+        if (depth > lcdDepthMax)
+            lcdDepthMax = depth;
+#endif
+        if (!twiBusy)
+        {
+            // The STOP of the last transaction may still be going out
+            while (TWCR & _BV(TWSTO))
+            {
+            }
+            twiBusy = true;
+            TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+        }
+    }
+}
+
+namespace hal
+{
+uint16_t entropy()
+{
+    // A7 is an unconnected analog-only input on the Nano; its noise plus
+    // timer jitter is good enough to pick IDs and back-off slots
+    uint16_t value = micros();
+    for (uint8_t i = 0; i < 16; ++i)
+        value = (uint16_t)((value << 1) | (value >> 15)) ^ analogRead(A7);
+    return value;
+}
+
+uint16_t supplyMillivolts()
+{
+    // Bandgap as input, AVcc as reference: reading = 1.1 V * 1024 / Vcc.
+    // analogRead() sets ADMUX again, so entropy() is not disturbed. The
+    // first conversion gives the bandgap time to start up.
+    ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+    uint16_t reading = 0;
+    for (uint8_t i = 0; i < 2; ++i)
+    {
+        ADCSRA |= _BV(ADSC);
+        while (ADCSRA & _BV(ADSC))
+        {
+        }
+        reading = ADC;
+    }
+    return reading != 0 ? (uint16_t)(1100UL * 1024 / reading) : 0;
+}
+
+void buzzerTone(uint16_t freqHz)
+{
+    if (freqHz < 16)
+    {
+        TCCR1A = 0; // OC1B off, the pin is PORTB2 again
+        TCCR1B = 0; // timer stopped
+        PORTB &= ~_BV(PORTB2);
+        return;
+    }
+    // CTC up to OCR1A at clk/8, toggling OC1B once per period
+    TCCR1B = 0;
+    TCNT1 = 0;
+    OCR1A = (uint16_t)(F_CPU / 16 / freqHz - 1);
+    OCR1B = 0;
+    TCCR1A = _BV(COM1B0);
+    TCCR1B = _BV(WGM12) | _BV(CS11);
+}
+
+void tickBegin(void (*fn)())
+{
+    tickFn = fn;
+    OCR0B = 128;
+    TIFR0 = _BV(OCF0B);
+    TIMSK0 |= _BV(OCIE0B);
+}
+
+void buttonEdgesBegin()
+{
+    const uint8_t pins[] = {PINS.button[0], PINS.button[1], PINS.button[2], PINS.button[3], PINS.button[4]};
+    uint8_t maskD = 0;
+    uint8_t maskB = 0;
+    for (uint8_t i = 0; i < sizeof(pins); ++i)
+    {
+        if (pins[i] < 8)
+            maskD |= 1 << pins[i];
+        else
+            maskB |= 1 << (pins[i] - 8);
+    }
+    edgeLastMask = readButtons();
+    PCMSK2 |= maskD; // PCINT16-23 = D0-D7
+    PCMSK0 |= maskB; // PCINT0-5 = D8-D13
+    PCIFR = (1 << PCIF2) | (1 << PCIF0);
+    PCICR |= (maskD ? (1 << PCIE2) : 0) | (maskB ? (1 << PCIE0) : 0);
+}
+
+bool buttonEdgePop(ButtonEdge &edge)
+{
+    if (edgeHead == edgeTail)
+        return false;
+    edge = edgeQueue[edgeTail & (EDGE_QUEUE_SLOTS - 1)];
+    __asm__ __volatile__("" ::: "memory"); // copy out before releasing the slot
+    ++edgeTail;
+    return true;
+}
+
+uint8_t eepromRead(uint16_t addr)
+{
+    return EEPROM.read(addr);
+}
+
+void eepromUpdate(uint16_t addr, uint8_t value)
+{
+    EEPROM.update(addr, value);
+}
+
+bool eepromReady()
+{
+    return eeprom_is_ready();
+}
+
+void serialBegin(uint32_t baud)
+{
+    Serial.begin(baud);
+}
+
+int serialRead()
+{
+    return Serial.read();
+}
+
+void serialPrint(const char *s)
+{
+    Serial.print(s);
+}
+
+void serialPrint(long value)
+{
+    Serial.print(value);
+}
+
+void serialPrintln(const char *s)
+{
+    Serial.println(s);
+}
+
+void serialPrint_P(const char *s)
+{
+    Serial.print((const __FlashStringHelper *)s);
+}
+
+void serialPrintln_P(const char *s)
+{
+    Serial.println((const __FlashStringHelper *)s);
+}
+
+uint8_t serialTxFree()
+{
+    return (uint8_t)Serial.availableForWrite();
+}
+
+void serialWrite(const uint8_t *data, uint8_t len)
+{
+    Serial.write(data, len);
+}
+
+// No malloc() in the sketch or its libraries, so the free RAM starts at the
+// end of .bss (_end) unless something did grow the heap (__brkval)
+extern uint8_t _end;
+extern char *__brkval;
+#define STACK_PAINT 0xC5
+
+static uint8_t *freeRamStart()
+{
+    return __brkval != NULL ? (uint8_t *)__brkval : &_end;
+}
+
+void stackPaint()
+{
+    // Everything below SP is free
+    uint8_t *top = (uint8_t *)SP;
+    for (uint8_t *p = freeRamStart(); p < top; ++p)
+        *p = STACK_PAINT;
+}
+
+uint16_t stackUnused()
+{
+    uint16_t count = 0;
+    for (const uint8_t *p = freeRamStart(); p <= (const uint8_t *)RAMEND && *p == STACK_PAINT; ++p)
+        ++count;
+    return count;
+}
+
+uint32_t powerDown(uint32_t maxMs)
+{
+    // Longest watchdog period that fits: 16 ms << prescaler (0..9)
+    uint8_t prescaler = 0;
+    while (prescaler < 9 && (16UL << (prescaler + 1)) <= maxMs)
+        ++prescaler;
+    if ((16UL << prescaler) > maxMs)
+    {
+        idle();
+        return 0;
+    }
+
+    Serial.flush(); // the UART and the TWI stop with the clock
+    while (twiBusy)
+    {
+    }
+    cli();
+    wdtFired = false;
+    MCUSR &= ~_BV(WDRF);
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDIE) | (prescaler & 7) | ((prescaler & 8) ? _BV(WDP3) : 0);
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sei();
+    sleep_cpu(); // the instruction after sei() runs before any interrupt
+    sleep_disable();
+    wdt_disable();
+
+    if (!wdtFired)
+        return 0; // a button: how long we slept is unknown
+    uint32_t slept = 16UL << prescaler;
+    cli();
+    timer0_millis += slept;
+    sei();
+    return slept;
+}
+
+// The HD44780 datasheet waits between the steps are left to the caller
+uint8_t lcdBegin()
+{
+    switch (lcdInitStep++)
+    {
+    case 0:
+        // SDA/SCL pull-ups, prescaler 1
+        pinMode(SDA, INPUT_PULLUP);
+        pinMode(SCL, INPUT_PULLUP);
+        TWSR = 0;
+        TWBR = (uint8_t)((F_CPU / LCD_I2C_HZ - 16) / 2);
+        TWCR = _BV(TWEN);
+        lcdPush(LCDQ_WAIT, 1); // all port pins low, backlight off
+        return 50;             // > 40 ms from power-on to the first write
+    case 1:
+    case 2:
+        lcdPush(LCDQ_NIBBLE, 0x30); // 8-bit mode, sent three times
+        return 5;                   // > 4.1 ms
+    case 3:
+        lcdPush(LCDQ_NIBBLE, 0x30);
+        return 1; // > 100 us
+    default:
+        lcdPush(LCDQ_NIBBLE, 0x20); // 4-bit mode from here on
+        lcdPush(LCDQ_COMMAND, HD_FUNCTION_4BIT);
+        lcdPush(LCDQ_COMMAND, HD_DISPLAY_ON);
+        lcdClear();
+        lcdPush(LCDQ_COMMAND, HD_ENTRY_LEFT);
+        lcdBacklight(true);
+        lcdInitStep = 0;
+        return 0;
+    }
+}
+
+void lcdClear()
+{
+    lcdPush(LCDQ_COMMAND, HD_CLEAR);
+    lcdPush(LCDQ_WAIT, HD_CLEAR_WAIT_WRITES);
+}
+
+void lcdSetCursor(uint8_t col, uint8_t row)
+{
+    // DDRAM rows start at 0x00 and 0x40
+    lcdPush(LCDQ_COMMAND, HD_SET_DDRAM | (row ? 0x40 : 0x00) | col);
+}
+
+void lcdPrint(char c)
+{
+    lcdPush(LCDQ_DATA, (uint8_t)c);
+}
+
+void lcdPrint(const char *s)
+{
+    while (*s)
+        lcdPrint(*s++);
+}
+
+void lcdBacklight(bool on)
+{
+    lcdPush(LCDQ_BACKLIGHT, on ? PCF_BACKLIGHT : 0);
+}
+
+uint8_t lcdQueueFree()
+{
+    return LCD_QUEUE_SLOTS - (uint8_t)(lcdHead - lcdTail);
+}
+
+#ifdef STATS
+uint32_t lcdI2cBytes()
+{
+    uint32_t bytes;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        bytes = lcdBytes;
+    }
+    return bytes;
+}
+
+uint8_t lcdQueueDepthMax()
+{
+    return lcdDepthMax;
+}
+
+uint16_t lcdQueueStalls()
+{
+    return lcdStalls;
+}
+
+uint16_t lcdNackCount()
+{
+    return lcdNacks;
+}
+#endif
+
+#ifdef USE_LORA
+void radioReset(bool hold)
+{
+    pinMode(PINS.loraRst, OUTPUT);
+    digitalWrite(PINS.loraRst, hold ? LOW : HIGH);
+}
+
+bool radioBegin(long freq)
+{
+    SPI.begin();
+    // Set chip select pin
+    pinMode(PINS.loraSs, OUTPUT);
+    digitalWrite(PINS.loraSs, HIGH);
+
+    // Tell the LoRa library which pins we wired (SS, DIO0). Reset is left
+    // out: radioReset() has done it, and LoRa.begin() would pulse it again
+    // with two blocking 10 ms delays.
+    LoRa.setPins(PINS.loraSs, -1, PINS.loraDio0);
+
+    if (!LoRa.begin(freq))
+        return false;
+
+    LoRa.setTxPower(RADIO.txPowerDbm);
+    LoRa.setSignalBandwidth(RADIO.bandwidthHz);
+    LoRa.setSpreadingFactor(RADIO.spreadingFactor);
+    LoRa.setCodingRate4(RADIO.codingRate);
+    LoRa.setPreambleLength(LORA_PREAMBLE_LEN);
+    return true;
+}
+
+void radioReceive()
+{
+    LoRa.onReceive(onRadioReceive);
+    LoRa.onTxDone(onRadioTxDone);
+    LoRa.receive();
+}
+
+bool radioBusy()
+{
+    return txBusy;
+}
+
+bool radioSend(const uint8_t *data, uint8_t len)
+{
+    // beginPacket() refuses while the modem is still in TX mode
+    if (!LoRa.beginPacket())
+        return false;
+    LoRa.write(data, len);
+    txBusy = true;
+    LoRa.endPacket(true); // Non-blocking, TxDone on DIO0
+    return true;
+}
+
+void radioSleep()
+{
+    LoRa.sleep();
+}
+
+void radioSniff()
+{
+    sniffResult = -1;
+    LoRa.onCadDone(onRadioCadDone);
+    LoRa.channelActivityDetection(); // CadDone on DIO0 after ~2 symbols
+}
+
+int8_t radioSniffResult()
+{
+    return sniffResult;
+}
+#endif
+}
+
+#endif // ARDUINO
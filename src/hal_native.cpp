@@ -0,0 +1,667 @@
+// HAL backend for the `native` env: a simulated board driven by sim.h.
+
+#ifndef ARDUINO
+
+#include "hal.h"
+#include "sim.h"
+#include "airtime.h"
+#include "rx_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+namespace
+{
+struct Packet
+{
+    std::vector<uint8_t> data;
+};
+
+uint64_t clockUs = 0;
+void (*tickFn)() = NULL;
+uint32_t idlePasses = 0;
+uint32_t powerDowns = 0;
+uint8_t pinLevels[sim::PIN_COUNT];
+bool edgesEnabled = false;
+uint8_t edgeLastMask = 0;
+std::deque<hal::ButtonEdge> edges; // pin-change interrupt queue
+uint16_t toneFreqs[sim::PIN_COUNT];
+uint8_t eepromCells[sim::EEPROM_SIZE];
+uint32_t entropyState = 1;
+uint16_t supplyMv = 5000;
+bool serialEcho = true;
+std::deque<char> serialRx;
+// UART TX buffer: bytes leave at baud / 10 per second, and a print that does
+// not fit waits for them as on the board (the core's ring holds 63)
+#define SERIAL_TX_BUFFER 63
+uint32_t serialBaud = 9600;
+uint8_t serialTxQueued = 0;
+uint64_t serialTxSinceUs = 0; // when the oldest queued byte started out
+
+char lcdCells[LCD_ROWS][LCD_COLS];
+uint8_t lcdCursorCol = 0;
+uint8_t lcdCursorRow = 0;
+uint32_t lcdOpCount = 0;
+uint8_t lcdInitStep = 0;
+
+bool radioPresent = true;
+bool radioReceiving = false;
+bool radioSleeping = false;
+// Frame whose (long) preamble started while the radio slept
+std::vector<uint8_t> radioHeld;
+int radioHeldRssi = 0;
+bool radioLoopback = false;
+int radioLoopbackRssi = -60;
+std::deque<Packet> radioSent;
+uint64_t radioAirtime = 0;
+uint64_t radioTxEndUs = 0; // transmitting until the clock reaches this
+uint32_t radioRefused = 0;
+int8_t sniffResult = 0;
+uint64_t sniffEndUs = 0; // CAD result ready at
+bool (*cadProbe)(void *ctx) = NULL;
+void *cadProbeCtx = NULL;
+
+// Same work as the DIO0 RxDone handler in hal_avr.cpp
+void radioRxDone(const uint8_t *data, uint8_t len, int rssi, int8_t snr)
+{
+    if (radioSleeping)
+    {
+        radioHeld.assign(data, data + len);
+        radioHeldRssi = rssi;
+        return;
+    }
+    if (!radioReceiving)
+        return;
+    RxPacket *slot = rxQueueReserve();
+    if (slot == NULL || len > RADIO_FRAME_MAX)
+        return;
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->rssi = rssi;
+    slot->snr = snr;
+    rxQueueCommit();
+}
+}
+
+namespace sim
+{
+void reset()
+{
+    clockUs = 0;
+    tickFn = NULL;
+    idlePasses = 0;
+    powerDowns = 0;
+    memset(pinLevels, HIGH, sizeof(pinLevels));
+    edgesEnabled = false;
+    edgeLastMask = 0;
+    edges.clear();
+    memset(toneFreqs, 0, sizeof(toneFreqs));
+    memset(eepromCells, 0xFF, sizeof(eepromCells));
+    supplyMv = 5000;
+    memset(lcdCells, ' ', sizeof(lcdCells));
+    lcdCursorCol = 0;
+    lcdCursorRow = 0;
+    lcdOpCount = 0;
+    lcdInitStep = 0;
+    serialRx.clear();
+    serialBaud = 9600;
+    serialTxQueued = 0;
+    serialTxSinceUs = 0;
+    radioPresent = true;
+    radioReceiving = false;
+    radioSleeping = false;
+    radioHeld.clear();
+    radioLoopback = false;
+    radioSent.clear();
+    radioAirtime = 0;
+    radioTxEndUs = 0;
+    radioRefused = 0;
+    sniffResult = 0;
+    sniffEndUs = 0;
+    RxPacket drain;
+    while (rxQueuePop(drain))
+        ;
+}
+
+uint64_t nowUs()
+{
+    return clockUs;
+}
+
+void advanceUs(uint64_t us)
+{
+    // The tick interrupt fires at every whole ms passed
+    uint64_t end = clockUs + us;
+    if (tickFn != NULL)
+    {
+        for (uint64_t t = (clockUs / 1000 + 1) * 1000; t <= end; t += 1000)
+        {
+            clockUs = t;
+            tickFn();
+        }
+    }
+    clockUs = end;
+}
+
+void advanceMs(uint32_t ms)
+{
+    advanceUs((uint64_t)ms * 1000);
+}
+
+void setPin(uint8_t pin, uint8_t level)
+{
+    if (pin >= PIN_COUNT)
+        return;
+    pinLevels[pin] = level;
+
+    // Pin-change interrupt on the button pins
+    uint8_t mask = hal::readButtons();
+    if (edgesEnabled && mask != edgeLastMask)
+    {
+        hal::ButtonEdge edge;
+        edge.atMs = (uint16_t)hal::millis();
+        edge.mask = mask;
+        edges.push_back(edge);
+    }
+    edgeLastMask = mask;
+}
+
+uint8_t pinLevel(uint8_t pin)
+{
+    return pin < PIN_COUNT ? pinLevels[pin] : HIGH;
+}
+
+void setButton(uint8_t pin, bool pressed)
+{
+    setPin(pin, pressed ? LOW : HIGH);
+}
+
+uint16_t toneFreq(uint8_t pin)
+{
+    return pin < PIN_COUNT ? toneFreqs[pin] : 0;
+}
+
+void setEntropySeed(uint32_t seed)
+{
+    entropyState = seed;
+}
+
+void setSupplyMillivolts(uint16_t mv)
+{
+    supplyMv = mv;
+}
+
+uint8_t *eeprom()
+{
+    return eepromCells;
+}
+
+void setSerialEcho(bool echo)
+{
+    serialEcho = echo;
+}
+
+void serialInput(const char *text)
+{
+    while (*text)
+        serialRx.push_back(*text++);
+}
+
+char lcdCell(uint8_t col, uint8_t row)
+{
+    if (col >= LCD_COLS || row >= LCD_ROWS)
+        return ' ';
+    return lcdCells[row][col];
+}
+
+void lcdRow(uint8_t row, char *out)
+{
+    for (uint8_t c = 0; c < LCD_COLS; ++c)
+        out[c] = lcdCell(c, row);
+    out[LCD_COLS] = '\0';
+}
+
+uint32_t lcdOps()
+{
+    return lcdOpCount;
+}
+
+uint32_t idleCount()
+{
+    return idlePasses;
+}
+
+uint32_t powerDownCount()
+{
+    return powerDowns;
+}
+
+void radioInject(const uint8_t *data, uint8_t len, int rssi, int8_t snrQuarterDb)
+{
+    radioRxDone(data, len, rssi, snrQuarterDb);
+}
+
+void setRadioLoopback(bool loopback, int rssi)
+{
+    radioLoopback = loopback;
+    radioLoopbackRssi = rssi;
+}
+
+size_t radioSentCount()
+{
+    return radioSent.size();
+}
+
+bool radioTakeSent(uint8_t *data, uint8_t *len)
+{
+    if (radioSent.empty())
+        return false;
+    const Packet &p = radioSent.front();
+    memcpy(data, p.data.data(), p.data.size());
+    *len = (uint8_t)p.data.size();
+    radioSent.pop_front();
+    return true;
+}
+
+uint64_t radioAirtimeUs()
+{
+    return radioAirtime;
+}
+
+uint32_t radioRefusedCount()
+{
+    return radioRefused;
+}
+
+void setRadioPresent(bool present)
+{
+    radioPresent = present;
+}
+
+void setCadProbe(bool (*probe)(void *ctx), void *ctx)
+{
+    cadProbe = probe;
+    cadProbeCtx = ctx;
+}
+}
+
+namespace hal
+{
+uint32_t millis()
+{
+    return (uint32_t)(clockUs / 1000);
+}
+
+uint32_t micros()
+{
+    return (uint32_t)clockUs;
+}
+
+void delay(uint32_t ms)
+{
+    sim::advanceMs(ms);
+}
+
+void idle()
+{
+    // The driver advances the clock between loop() passes; just count them
+    ++idlePasses;
+}
+
+uint32_t powerDown(uint32_t maxMs)
+{
+    // As idle(): the clock is the driver's, which "wakes" us every pass
+    (void)maxMs;
+    ++idlePasses;
+    ++powerDowns;
+    return 0;
+}
+
+void pinInputPullup(uint8_t pin)
+{
+    (void)pin; // pins idle HIGH until sim::setPin() drives them
+}
+
+void pinOutput(uint8_t pin)
+{
+    (void)pin;
+}
+
+uint8_t readPin(uint8_t pin)
+{
+    return sim::pinLevel(pin);
+}
+
+void writePin(uint8_t pin, uint8_t level)
+{
+    sim::setPin(pin, level);
+}
+
+uint8_t readButtons()
+{
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < 5; ++i)
+    {
+        if (pinLevels[PINS.button[i]] == LOW)
+            mask |= 1 << i;
+    }
+    return mask;
+}
+
+void buttonEdgesBegin()
+{
+    edgesEnabled = true;
+    edgeLastMask = readButtons();
+}
+
+bool buttonEdgePop(ButtonEdge &edge)
+{
+    if (edges.empty())
+        return false;
+    edge = edges.front();
+    edges.pop_front();
+    return true;
+}
+
+void buzzerTone(uint16_t freqHz)
+{
+    toneFreqs[PINS.buzzer] = freqHz;
+}
+
+void tickBegin(void (*fn)())
+{
+    tickFn = fn;
+}
+
+uint16_t entropy()
+{
+    entropyState = entropyState * 1103515245UL + 12345;
+    return (uint16_t)(entropyState >> 16);
+}
+
+uint16_t supplyMillivolts()
+{
+    return supplyMv;
+}
+
+uint8_t eepromRead(uint16_t addr)
+{
+    return addr < sim::EEPROM_SIZE ? eepromCells[addr] : 0xFF;
+}
+
+void eepromUpdate(uint16_t addr, uint8_t value)
+{
+    if (addr < sim::EEPROM_SIZE)
+        eepromCells[addr] = value;
+}
+
+bool eepromReady()
+{
+    return true;
+}
+
+void serialBegin(uint32_t baud)
+{
+    serialBaud = baud;
+}
+
+int serialRead()
+{
+    if (serialRx.empty())
+        return -1;
+    char c = serialRx.front();
+    serialRx.pop_front();
+    return (uint8_t)c;
+}
+
+static uint64_t serialByteUs()
+{
+    return 10000000ULL / serialBaud;
+}
+
+static void serialTxDrain()
+{
+    if (serialTxQueued == 0)
+    {
+        serialTxSinceUs = clockUs;
+        return;
+    }
+    uint64_t done = (clockUs - serialTxSinceUs) / serialByteUs();
+    if (done >= serialTxQueued)
+    {
+        serialTxQueued = 0;
+        serialTxSinceUs = clockUs;
+    }
+    else
+    {
+        serialTxQueued -= (uint8_t)done;
+        serialTxSinceUs += done * serialByteUs();
+    }
+}
+
+// Queue len bytes, letting the virtual clock run while the buffer is full
+static void serialTxPut(size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        serialTxDrain();
+        if (serialTxQueued >= SERIAL_TX_BUFFER)
+        {
+            sim::advanceUs(serialTxSinceUs + serialByteUs() - clockUs);
+            serialTxDrain();
+        }
+        ++serialTxQueued;
+    }
+}
+
+void serialPrint(const char *s)
+{
+    serialTxPut(strlen(s));
+    if (serialEcho)
+        fputs(s, stdout);
+}
+
+void serialPrint(long value)
+{
+    char text[24];
+    int len = snprintf(text, sizeof(text), "%ld", value);
+    serialTxPut(len);
+    if (serialEcho)
+        fputs(text, stdout);
+}
+
+void serialPrintln(const char *s)
+{
+    serialTxPut(strlen(s) + 2);
+    if (serialEcho)
+        puts(s);
+}
+
+void serialPrint_P(const char *s)
+{
+    serialPrint(s);
+}
+
+void serialPrintln_P(const char *s)
+{
+    serialPrintln(s);
+}
+
+uint8_t serialTxFree()
+{
+    serialTxDrain();
+    return SERIAL_TX_BUFFER - serialTxQueued;
+}
+
+void serialWrite(const uint8_t *data, uint8_t len)
+{
+    serialTxPut(len);
+    if (serialEcho)
+        fwrite(data, 1, len, stdout);
+}
+
+void stackPaint()
+{
+}
+
+uint16_t stackUnused()
+{
+    return 0;
+}
+
+// Same steps and waits as the HD44780 power-on sequence on the board
+uint8_t lcdBegin()
+{
+    static const uint8_t waitMs[] = {50, 5, 5, 1};
+    if (lcdInitStep < sizeof(waitMs))
+        return waitMs[lcdInitStep++];
+    lcdInitStep = 0;
+    memset(lcdCells, ' ', sizeof(lcdCells));
+    lcdCursorCol = 0;
+    lcdCursorRow = 0;
+    return 0;
+}
+
+void lcdClear()
+{
+    memset(lcdCells, ' ', sizeof(lcdCells));
+    lcdCursorCol = 0;
+    lcdCursorRow = 0;
+    ++lcdOpCount;
+}
+
+void lcdSetCursor(uint8_t col, uint8_t row)
+{
+    lcdCursorCol = col;
+    lcdCursorRow = row < LCD_ROWS ? row : LCD_ROWS - 1;
+    ++lcdOpCount;
+}
+
+void lcdPrint(char c)
+{
+    // Like the HD44780, writes past the visible width are lost
+    if (lcdCursorCol < LCD_COLS)
+        lcdCells[lcdCursorRow][lcdCursorCol] = c;
+    ++lcdCursorCol;
+    ++lcdOpCount;
+}
+
+void lcdPrint(const char *s)
+{
+    while (*s)
+        lcdPrint(*s++);
+}
+
+void lcdBacklight(bool on)
+{
+    // The virtual LCD shows text only
+    (void)on;
+}
+
+// The virtual LCD takes every write at once: the queue never fills
+uint8_t lcdQueueFree()
+{
+    return LCD_QUEUE_SLOTS;
+}
+
+#ifdef STATS
+uint32_t lcdI2cBytes()
+{
+    return lcdOpCount * LCD_I2C_BYTES_PER_OP;
+}
+
+uint8_t lcdQueueDepthMax()
+{
+    return 0;
+}
+
+uint16_t lcdQueueStalls()
+{
+    return 0;
+}
+
+uint16_t lcdNackCount()
+{
+    return 0;
+}
+#endif
+
+#ifdef USE_LORA
+void radioReset(bool hold)
+{
+    (void)hold;
+}
+
+bool radioBegin(long freq)
+{
+    (void)freq;
+    return radioPresent;
+}
+
+void radioReceive()
+{
+    radioReceiving = true;
+    radioSleeping = false;
+    // The rest of a frame whose preamble a sniff caught
+    if (!radioHeld.empty())
+    {
+        std::vector<uint8_t> held;
+        held.swap(radioHeld);
+        radioRxDone(held.data(), (uint8_t)held.size(), radioHeldRssi, 0);
+    }
+}
+
+bool radioBusy()
+{
+    return clockUs < radioTxEndUs;
+}
+
+bool radioSend(const uint8_t *data, uint8_t len)
+{
+    if (radioBusy())
+    {
+        ++radioRefused;
+        return false;
+    }
+    // Woken from sleep; receives again after TxDone
+    radioSleeping = false;
+    radioReceiving = true;
+    Packet p;
+    p.data.assign(data, data + len);
+    radioSent.push_back(p);
+    uint32_t airtime = loraTimeOnAirUs(len, RADIO.spreadingFactor, RADIO.bandwidthHz,
+                                       RADIO.codingRate, LORA_PREAMBLE_LEN);
+    radioAirtime += airtime;
+    radioTxEndUs = clockUs + airtime;
+    if (radioLoopback)
+        radioRxDone(data, len, radioLoopbackRssi, 0);
+    return true;
+}
+
+void radioSleep()
+{
+    radioReceiving = false;
+    radioSleeping = true;
+}
+
+void radioSniff()
+{
+    // CAD finds a frame injected while asleep (its preamble is still going)
+    // or one the channel model has on the air; standby afterwards
+    radioReceiving = false;
+    bool heard = !radioHeld.empty() || (cadProbe != NULL && cadProbe(cadProbeCtx));
+    sniffResult = heard ? 1 : 0;
+    uint32_t symbolUs = (1UL << RADIO.spreadingFactor) * 1000000UL / RADIO.bandwidthHz;
+    sniffEndUs = clockUs + 2 * symbolUs;
+}
+
+int8_t radioSniffResult()
+{
+    return clockUs < sniffEndUs ? -1 : sniffResult;
+}
+#endif
+}
+
+#endif // !ARDUINO
@@ -0,0 +1,155 @@
+#include "journal.h"
+#include "hal.h"
+
+static_assert(sizeof(JournalRecord) == 8, "JournalRecord must stay packed");
+// The ring's sequence numbers must not line up again after one lap, or the
+// end of the ring could not be found
+static_assert(JOURNAL_SLOTS >= 2 && JOURNAL_SLOTS < 256 && 256 % JOURNAL_SLOTS != 0,
+              "JOURNAL_SLOTS out of range");
+
+// Records waiting for the EEPROM, oldest at queueHead
+static JournalRecord queue[JOURNAL_QUEUE_SLOTS];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+static uint8_t byteIndex = 0; // next byte of the oldest record to write
+
+static uint8_t head = 0; // ring slot the next appended record goes to
+static uint8_t nextSeq = 0;
+static uint32_t lastAppendAt = 0;
+static uint16_t dropped = 0;
+
+// Same order as JournalEvent
+static const char eventNames[][6] PROGMEM = {"boot", "panic", "acked", "heard", "up", "lost"};
+
+static uint8_t crc8(const uint8_t *data, uint8_t len)
+{
+    uint8_t crc = 0;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+            crc = (crc & 0x80) ? (uint8_t)(crc << 1) ^ 0x07 : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t slotAddr(uint8_t slot)
+{
+    return JOURNAL_EEPROM_ADDR + (uint16_t)slot * sizeof(JournalRecord);
+}
+
+// False for a blank, torn or corrupted slot
+static bool readSlot(uint8_t slot, JournalRecord &record)
+{
+    uint8_t *bytes = (uint8_t *)&record;
+    uint16_t addr = slotAddr(slot);
+    for (uint8_t i = 0; i < sizeof(JournalRecord); ++i)
+        bytes[i] = hal::eepromRead(addr + i);
+    return record.crc == crc8(bytes, sizeof(JournalRecord) - 1);
+}
+
+void journalBegin(uint8_t node, uint32_t now)
+{
+    // The newest record is the valid one whose successor does not continue
+    // its sequence; an empty ring starts at slot 0
+    for (uint8_t i = 0; i < JOURNAL_SLOTS; ++i)
+    {
+        JournalRecord record, next;
+        uint8_t n = (i + 1) % JOURNAL_SLOTS;
+        if (readSlot(i, record) && (!readSlot(n, next) || next.seq != (uint8_t)(record.seq + 1)))
+        {
+            head = n;
+            nextSeq = record.seq + 1;
+            break;
+        }
+    }
+    journalAppend(JOURNAL_BOOT, node, 0, 0, now);
+}
+
+bool journalAppend(uint8_t type, uint8_t node, int8_t rssi, uint8_t arg, uint32_t now)
+{
+    if (queueCount == JOURNAL_QUEUE_SLOTS)
+    {
+        ++dropped;
+        return false;
+    }
+
+    JournalRecord &record = queue[(queueHead + queueCount) % JOURNAL_QUEUE_SLOTS];
+    uint32_t deltaS = (now - lastAppendAt) / 1000;
+    if (deltaS > 0xFFFF)
+    {
+        deltaS = 0xFFFF;
+        lastAppendAt = now;
+    }
+    else
+        lastAppendAt += deltaS * 1000; // keep the remainder, deltas add up to uptime
+    record.deltaS = (uint16_t)deltaS;
+    record.seq = nextSeq++;
+    record.type = type;
+    record.node = node;
+    record.rssi = rssi;
+    record.arg = arg;
+    record.crc = crc8((const uint8_t *)&record, sizeof(JournalRecord) - 1);
+    ++queueCount;
+    head = (head + 1) % JOURNAL_SLOTS;
+    return true;
+}
+
+void journalService()
+{
+    if (queueCount == 0 || !hal::eepromReady())
+        return;
+
+    const uint8_t *bytes = (const uint8_t *)&queue[queueHead];
+    uint8_t slot = (head + JOURNAL_SLOTS - queueCount) % JOURNAL_SLOTS;
+    hal::eepromUpdate(slotAddr(slot) + byteIndex, bytes[byteIndex]);
+    if (++byteIndex == sizeof(JournalRecord))
+    {
+        byteIndex = 0;
+        queueHead = (queueHead + 1) % JOURNAL_QUEUE_SLOTS;
+        --queueCount;
+    }
+}
+
+bool journalPending()
+{
+    return queueCount != 0;
+}
+
+void journalDump()
+{
+    hal::serialPrintln_P(PSTR("seq +s event node rssi arg"));
+    for (uint8_t i = 0; i < JOURNAL_SLOTS; ++i)
+    {
+        JournalRecord record;
+        if (!readSlot((head + i) % JOURNAL_SLOTS, record))
+            continue;
+        hal::serialPrint((long)record.seq);
+        hal::serialPrint_P(PSTR(" +"));
+        hal::serialPrint((long)record.deltaS);
+        hal::serialPrint_P(PSTR(" "));
+        if (record.type < sizeof(eventNames) / sizeof(eventNames[0]))
+            hal::serialPrint_P(eventNames[record.type]);
+        else
+            hal::serialPrint((long)record.type);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)record.node);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)record.rssi);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)record.arg);
+        hal::serialPrintln_P(PSTR(""));
+    }
+}
+
+const char *journalEventName(uint8_t type)
+{
+    if (type < sizeof(eventNames) / sizeof(eventNames[0]))
+        return eventNames[type];
+    return PSTR("event");
+}
+
+uint16_t journalDropped()
+{
+    return dropped;
+}
@@ -0,0 +1,162 @@
+#include "lcd_fb.h"
+#include "hal.h"
+#include "fmt.h"
+
+#define LCD_CELLS (LCD_ROWS * LCD_COLS)
+#define CURSOR_UNKNOWN 0xFF
+
+#if LCD_CELLS > 32
+#error "dirty mask holds 32 cells"
+#endif
+
+static char cells[LCD_CELLS];
+static uint32_t dirty = 0;              // one bit per cell
+static uint8_t cursor = CURSOR_UNKNOWN; // where the LCD's address counter points
+static uint32_t lastFlush = 0;
+
+#ifdef STATS
+// I2C throughput over the last full second
+static uint32_t statsWindowStart = 0;
+static uint32_t statsBytesAtStart = 0;
+static uint32_t bytesPerSec = 0;
+#endif
+
+void fbBegin()
+{
+    for (uint8_t i = 0; i < LCD_CELLS; ++i)
+        cells[i] = ' ';
+    dirty = 0;
+    cursor = CURSOR_UNKNOWN;
+}
+
+void fbPutChar(uint8_t col, uint8_t row, char c)
+{
+    if (col >= LCD_COLS || row >= LCD_ROWS)
+        return;
+    uint8_t i = row * LCD_COLS + col;
+    if (cells[i] != c)
+    {
+        cells[i] = c;
+        dirty |= 1UL << i;
+    }
+}
+
+void fbClear()
+{
+    for (uint8_t row = 0; row < LCD_ROWS; ++row)
+        fbClearRow(row);
+}
+
+void fbClearRow(uint8_t row)
+{
+    for (uint8_t col = 0; col < LCD_COLS; ++col)
+        fbPutChar(col, row, ' ');
+}
+
+void fbPrint(uint8_t col, uint8_t row, const char *s)
+{
+    while (*s && col < LCD_COLS)
+        fbPutChar(col++, row, *s++);
+}
+
+void fbPrintN(uint8_t col, uint8_t row, const char *s, uint8_t len)
+{
+    for (uint8_t i = 0; i < len && col < LCD_COLS; ++i)
+        fbPutChar(col++, row, s[i]);
+}
+
+void fbPrint_P(uint8_t col, uint8_t row, const char *s)
+{
+    char c;
+    while ((c = (char)pgm_read_byte(s++)) != '\0' && col < LCD_COLS)
+        fbPutChar(col++, row, c);
+}
+
+void fbPrintNumber(uint8_t col, uint8_t row, uint8_t width, unsigned long value)
+{
+    if (width > 5)
+        width = 5;
+    unsigned long limit = 1;
+    for (uint8_t i = 0; i < width; ++i)
+        limit *= 10;
+    if (value >= limit)
+        value = limit - 1;
+
+    char digits[5];
+    fbPrintN(col, row, digits, fmtUnsigned(digits, (uint16_t)value, width));
+}
+
+// Send dirty runs, at most budget LCD writes. The HD44780 auto-increments its
+// address, so a run needs one setCursor and is skipped when already there.
+static void flushRuns(uint8_t budget)
+{
+    uint8_t ops = 0;
+    uint8_t i = 0;
+    while (dirty != 0 && i < LCD_CELLS)
+    {
+        if (!(dirty & (1UL << i)))
+        {
+            ++i;
+            continue;
+        }
+
+        if (cursor != i)
+        {
+            if (ops + 2 > budget)
+                break;
+            hal::lcdSetCursor(i % LCD_COLS, i / LCD_COLS);
+            ++ops;
+        }
+        else if (ops + 1 > budget)
+            break;
+
+        uint8_t rowEnd = (i / LCD_COLS + 1) * LCD_COLS;
+        while (i < rowEnd && (dirty & (1UL << i)) && ops < budget)
+        {
+            hal::lcdPrint(cells[i]);
+            dirty &= ~(1UL << i);
+            ++ops;
+            ++i;
+        }
+        // Past the last column the address counter leaves the visible row
+        cursor = i < rowEnd ? i : CURSOR_UNKNOWN;
+    }
+}
+
+#ifdef STATS
+static void updateStats(uint32_t now)
+{
+    if (now - statsWindowStart >= 1000)
+    {
+        uint32_t total = hal::lcdI2cBytes();
+        bytesPerSec = total - statsBytesAtStart;
+        statsBytesAtStart = total;
+        statsWindowStart = now;
+    }
+}
+#endif
+
+bool fbFlush(uint32_t now)
+{
+#ifdef STATS
+    updateStats(now);
+#endif
+    if (dirty == 0 || now - lastFlush < LCD_FRAME_MS)
+        return false;
+    lastFlush = now;
+    uint8_t room = hal::lcdQueueFree();
+    flushRuns(room < LCD_FLUSH_MAX_OPS ? room : LCD_FLUSH_MAX_OPS);
+    return true;
+}
+
+void fbFlushAll()
+{
+    flushRuns(0xFF);
+}
+
+#ifdef STATS
+uint32_t fbI2cBytesPerSec()
+{
+    return bytesPerSec;
+}
+#endif
@@ -0,0 +1,101 @@
+#include "log.h"
+#include "hal.h"
+
+static uint8_t lineLen = 0;
+static uint8_t level = LOG_LEVEL;
+#ifdef STATS
+static uint16_t written = 0;
+static uint16_t dropped = 0;
+#endif
+
+static const char levelLetters[] PROGMEM = "EWID";
+
+bool logBegin(uint8_t msgLevel)
+{
+#ifdef TELEMETRY
+    // The port carries binary records
+    (void)msgLevel;
+    return false;
+#endif
+    if (msgLevel > level)
+        return false;
+    if (hal::serialTxFree() < LOG_LINE_BYTES)
+    {
+#ifdef STATS
+        if (dropped != 0xFFFF)
+            ++dropped;
+#endif
+        return false;
+    }
+    uint8_t start[2] = {pgm_read_byte(&levelLetters[msgLevel]), ' '};
+    hal::serialWrite(start, 2);
+    lineLen = 2;
+    return true;
+}
+
+static void put(char c)
+{
+    if (lineLen < 1 + LOG_LINE_MAX)
+    {
+        hal::serialWrite((const uint8_t *)&c, 1);
+        ++lineLen;
+    }
+}
+
+void logText_P(const char *s)
+{
+    char c;
+    while ((c = (char)pgm_read_byte(s++)) != '\0')
+        put(c);
+}
+
+void logText(const char *s, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; ++i)
+        put(s[i]);
+}
+
+void logNumber(long value)
+{
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long)value : (unsigned long)value;
+    if (value < 0)
+        put('-');
+    char digits[10];
+    uint8_t n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (n > 0)
+        put(digits[--n]);
+}
+
+void logEnd()
+{
+    uint8_t end[2] = {'\r', '\n'};
+    hal::serialWrite(end, 2);
+    STAT_INC(written);
+}
+
+void logSetLevel(uint8_t newLevel)
+{
+    level = newLevel > LOG_LEVEL ? LOG_LEVEL : newLevel;
+}
+
+uint8_t logLevel()
+{
+    return level;
+}
+
+#ifdef STATS
+uint16_t logWritten()
+{
+    return written;
+}
+
+uint16_t logDropped()
+{
+    return dropped;
+}
+#endif
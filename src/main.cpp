@@ -2,105 +2,158 @@
 // - 5 buttons (active LOW, use INPUT_PULLUP)
 // - piezo buzzer
 // - 1602 LCD with I2C backpack (4 wires: VCC/GND/SDA/SCL)
-// - LoRa RFM9x (optional; enable by defining USE_LORA below)
+// - LoRa RFM9x (optional; enable by defining USE_LORA in include/config.h)
+//
+// Pin maps, feature switches and timing constants are in include/config.h.
+// All hardware access goes through the HAL (include/hal.h) so the same logic
+// also builds for the host-native simulator (`pio run -e native`).
 
-#include <Arduino.h>
-#include <Wire.h>
-#include <LiquidCrystal_I2C.h>
-#include <EEPROM.h>
+#include <string.h>
+#include "hal.h"
+#include "fmt.h"
+#include "frame.h"
+#include "rx_queue.h"
+#include "tx_queue.h"
+#include "relay.h"
+#include "auth.h"
+#include "beacon_slots.h"
+#include "node_table.h"
+#include "journal.h"
+#include "log.h"
+#include "telemetry.h"
+#include "lcd_fb.h"
+#include "buttons.h"
+#include "scheduler.h"
+#include "buzzer.h"
+#include "profiler.h"
 
-// ============ PIN DEFINITIONS ============
-// Button pins (active LOW with INPUT_PULLUP)
-#define PIN_BUTTON_1 8
-#define PIN_BUTTON_2 4
-#define PIN_BUTTON_3 5
-#define PIN_BUTTON_4 6
-#define PIN_BUTTON_5 7
-
-// Buzzer pin (PWM-capable)
-#define PIN_BUZZER 10
-
-// I2C LCD address and dimensions
-#define I2C_LCD_ADDR 0x27
-#define LCD_COLS 16
-#define LCD_ROWS 2
-
-// ============ LORA PINS & CONFIG ============
-// Uncomment to enable LoRa functionality (requires LoRa lib in platformio.ini)
-#define USE_LORA
-
-#ifdef USE_LORA
-#include <SPI.h>
-#include <LoRa.h>
-// Default LoRa pins for many Arduino Uno/Nano RFM9x modules
-// Adjust these to match your wiring if different.
-#define PIN_LORA_SS 15 // CS
-// Map RST to D9 to avoid conflict with the interrupt pin (D2)
-#define PIN_LORA_RST 2
-// Interrupt pin for LoRa RX events (DIO0 / G0)
-#define PIN_LORA_DIO0 3
-// LoRa SPI pin mapping (you provided these pins):
-// Note: On an Arduino Nano (ATmega168) the hardware SPI pins are fixed to D11/D12/D13.
-// If you're using a different board where SPI pins are remappable, these defines let you
-// document your wiring. If you're on a Nano, wire MOSI->D11, MISO->D12, SCK->D13 instead.
-// Module G0 pin (labelled G0 on the module) is the same as DIO0 and should be wired to D2
-#endif
-
-// ============ OPERATIONAL CONSTANTS ============
-const unsigned long DEBOUNCE_MS = 10;
-const unsigned long BAUD_RATE = 9600;
-const unsigned long LORA_FREQ = 915E6;  // 915 MHz
-const unsigned int BEEP_DURATION_MS = 80;
-const unsigned int BEEP_FREQ_HZ = 500; // Change to 4000 in the future
-// How often the transmitter re-sends the 'pressed' packet while a button is held (ms)
-#define HOLD_SEND_INTERVAL_MS 200
-// How long the receiver will keep showing a received press without updates before clearing (ms)
-#define RECEIVE_TIMEOUT_MS 1000
-// Naming constants
-#define NAME_MAX_LEN 12
-#define NAME_EEPROM_ADDR 0
-#define LONG_PRESS_MS 1000
-
-LiquidCrystal_I2C lcd(I2C_LCD_ADDR, LCD_COLS, LCD_ROWS);
+// The frame codec (lib/frame) carries names of the same length
+static_assert(NAME_MAX_LEN == FRAME_NAME_MAX, "NAME_MAX_LEN must match FRAME_NAME_MAX");
+#ifdef ACCEPT_LEGACY_FRAMES
+#define LEGACY_FRAMES true
+#else
+#define LEGACY_FRAMES false
+#endif
 
 // State
-// Debounce / button state tracking
-byte stableState[5] = {HIGH, HIGH, HIGH, HIGH, HIGH};
-byte lastReading[5] = {HIGH, HIGH, HIGH, HIGH, HIGH};
-unsigned long lastDebounce[5] = {0, 0, 0, 0, 0};
+// (button debounce and long-press tracking live in buttons.cpp)
 bool loRaOk = false;
-// Non-blocking buzzer state
-unsigned long buzzerEndTime = 0;
-byte buzzerFreqActive = 0;
-// Per-button last time we re-sent a hold packet (transmitter)
-unsigned long lastHoldSend[5] = {0, 0, 0, 0, 0};
-// Per-remote-button last received timestamp (receiver) for buttons 1..4
-unsigned long lastReceivedAt[4] = {0, 0, 0, 0};
+// Beeps and the panic siren are played by the buzzer sequencer (buzzer.h)
+// Remote units, their presses and panics are tracked in the node table (node_table.h)
 
 // Naming mode state
 bool namingMode = false;
 char deviceName[NAME_MAX_LEN + 1];
 byte namePos = 0;
-// Button long-press tracking
-unsigned long pressStart[5] = {0, 0, 0, 0, 0};
-byte longPressHandled[5] = {0, 0, 0, 0, 0};
 
-// Panic mode state
+// Panic mode state: our own panic and/or remote ones (NODE_PANIC in the node table)
 bool panicMode = false;
-unsigned long panicBeepLastTime = 0;
-char panicName[NAME_MAX_LEN + 1];
-bool panicBeepState = false;  // tracks if beeping or silent
-#define PANIC_BEEP_INTERVAL 100  // milliseconds for each on/off cycle (alternating steady)
+// The panic screen shows one active panic at a time and cycles through them
+#define PANIC_VIEW_OWN 0xFF  // our own panic, else a node table slot
+#define PANIC_CYCLE_MS 2000
+byte panicView = PANIC_VIEW_OWN;
+unsigned long panicViewSince = 0;
+bool ownPanic = false;
+byte panicFramesSent = 0;
+byte panicSeq = 0;  // sequence number of our panic
+// Our own panic: retried fast until a receiver acknowledges it, then kept alive slowly
+bool panicAcked = false;
+unsigned long panicStartedAt = 0;
+unsigned long panicAckLatency = 0;  // ms from the button press to the first ACK
+// (retry and keepalive intervals in config.h)
+// Acknowledgement waiting to go out for a received panic
+byte ackNode = FRAME_NODE_LEGACY;
+byte ackSeq = 0;
+#define ACK_JITTER_MS 600  // random delay so several receivers do not ACK at once
+
+// Radio identity: binary frames carry nodeId instead of the name
+byte nodeId = 0;
+byte nameAnnounceLeft = NAME_ANNOUNCE_FRAMES;  // frames still carrying the name TLV
+byte beaconCount = 0;
+#ifdef STATE_BEACONS
+// What receivers act on in our state snapshot (ownState())
+#define STATE_NEWS ((1 << BUTTON_SEND) | FRAME_STATE_PANIC)
+byte stateNewsSent = 0;  // STATE_NEWS bits of the last snapshot sent
+byte stateQuietBeacons = 0;
+#endif
+#ifdef RELAY_MODE
+byte pressSeq = 0;  // sequence number of our last press/release frame
+#endif
 
 // RSSI signal strength display (0-100% where 100 is strongest)
 byte rssiPercent = 0;
 unsigned long lastRssiUpdate = 0;
+bool linkUp = false;  // heard something within RSSI_TIMEOUT (journaled on change)
 #define RSSI_MIN -120  // Weakest signal (0%)
 #define RSSI_MAX -30   // Strongest signal (100%)
+#ifdef TDMA_BEACONS
+#define RSSI_TIMEOUT (TDMA_SUPERFRAME_MS + TDMA_SLOT_MS)  // one beacon per superframe
+#else
 #define RSSI_TIMEOUT 5000  // milliseconds before resetting to 0 (SF10 packets ~500ms)
+#endif
+
+#ifdef BATTERY_MODE
+// Radio between frames: in receive, asleep, or sniffing for a preamble (CAD)
+enum
+{
+    RADIO_LISTEN,
+    RADIO_ASLEEP,
+    RADIO_SNIFF
+};
+byte radioState = RADIO_LISTEN;
+unsigned long listenUntil = 0;  // stay awake and in receive until then
+unsigned long sniffAt = 0;      // next CAD while asleep
+uint16_t batteryRxSeen = 0;     // rxQueueReceived() at the last check
+uint16_t batterySniffs = 0;
+uint16_t batteryWakeups = 0;    // sniffs that heard a preamble
+#endif
+
+// Boot: setup() only does what takes no time, so the buttons are live within
+// a few ms of reset. The radio and then the LCD come up afterwards, one step
+// per TASK_BOOT run; frames queued meanwhile go on air once the radio is up,
+// and drawing stays in the shadow framebuffer until the LCD is.
+enum
+{
+    BOOT_RADIO_RESET,  // radio held in reset
+    BOOT_RADIO,        // reset released, radio settling
+    BOOT_LCD,          // HD44780 power-on sequence, see hal::lcdBegin()
+    BOOT_DONE
+};
+#ifdef USE_LORA
+byte bootStep = BOOT_RADIO_RESET;
+#else
+byte bootStep = BOOT_LCD;
+#endif
+// ms from reset until each part was ready
+uint16_t bootButtonsMs = 0;
+uint16_t bootRadioMs = 0;
+uint16_t bootLcdMs = 0;
+
+// Jobs run by the scheduler (scheduler.h) instead of being re-checked every loop() pass
+enum
+{
+    TASK_BUTTONS,       // sample/debounce, every BUTTON_SAMPLE_MS
+    TASK_DISPLAY,       // idle or panic screen, every 100 ms
+    TASK_LCD_FLUSH,     // push shadow changes, every LCD_FRAME_MS
+    TASK_RSSI_TIMEOUT,  // RSSI_TIMEOUT after the last packet (one-shot)
+    TASK_PANIC_RESEND,  // our panic frame repeat, see panicRetryDelay() (one-shot)
+    TASK_BEACON,        // silent test packet, every BEACON_INTERVAL_MS or in our slot
+    TASK_HOLD_RESEND,   // button 4 press repeat or state beacon while held, every HOLD_RESEND_MS
+    TASK_RX_TIMEOUT,    // clear a received press after RECEIVE_TIMEOUT_MS (one-shot)
+    TASK_SEND_ACK,      // acknowledge a received panic after a random delay (one-shot)
+    TASK_BOOT,          // next step of bringing up the radio and the LCD (one-shot)
+    TASK_MESSAGE,       // end a message screen like "Name saved" after MESSAGE_MS (one-shot)
+#ifdef TELEMETRY
+    TASK_TELEMETRY,     // loop stats record, every TELEMETRY_PERIOD_MS
+#endif
+    TASK_COUNT
+};
+static_assert(TASK_COUNT == SCHED_MAX_TASKS, "set SCHED_MAX_TASKS (config.h) to the task count");
+#define DISPLAY_INTERVAL_MS 100
+#define MESSAGE_MS 600
 
 // Helper: convert RSSI dBm to percentage (0-100%)
-void updateRssiDisplay(int rssi)
+byte rssiToPercent(int rssi)
 {
     // Clamp RSSI to valid range
     if (rssi > RSSI_MAX)
@@ -109,12 +162,51 @@ void updateRssiDisplay(int rssi)
         rssi = RSSI_MIN;
     
     // Convert dBm to percentage
-    rssiPercent = map(rssi, RSSI_MIN, RSSI_MAX, 0, 100);
-    lastRssiUpdate = millis();
+    return (long)(rssi - RSSI_MIN) * 100 / (RSSI_MAX - RSSI_MIN);
+}
+
+// Helper: frames may be queued: the radio is up, or still coming up
+bool radioUsable()
+{
+    return loRaOk || bootStep < BOOT_LCD;
+}
+
+// Helper: a notable event goes into the journal, the log and the telemetry
+void recordEvent(uint8_t type, uint8_t node, int rssi, uint8_t arg, uint32_t now)
+{
+    int8_t rssi8 = rssi < -128 ? -128 : rssi;
+    journalAppend(type, node, rssi8, arg, now);
+    if (LOG_ON(LOG_INFO))
+    {
+        logText_P(journalEventName(type));
+        logText_P(PSTR(" node "));
+        logNumber(node);
+        logText_P(PSTR(" rssi "));
+        logNumber(rssi8);
+        logText_P(PSTR(" arg "));
+        logNumber(arg);
+        logEnd();
+    }
+#ifdef TELEMETRY
+    telEvent(type, node, rssi8, arg, now);
+#endif
+}
+
+// Helper: show the RSSI of the last packet received
+void updateRssiDisplay(int rssi)
+{
+    rssiPercent = rssiToPercent(rssi);
+    lastRssiUpdate = hal::millis();
+    if (!linkUp)
+    {
+        linkUp = true;
+        recordEvent(JOURNAL_LINK_UP, 0, rssi, 0, lastRssiUpdate);
+    }
+    schedIn(TASK_RSSI_TIMEOUT, lastRssiUpdate, RSSI_TIMEOUT + 1);
 }
 
 // Helper: valid characters for naming (capital letters and digits)
-const char VALID_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+const char VALID_CHARS[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
 #define VALID_CHARS_COUNT 37  // 26 letters + 10 digits + 1 space
 
 // Helper: get next valid character
@@ -122,10 +214,10 @@ char getNextChar(char current)
 {
     for (int i = 0; i < VALID_CHARS_COUNT - 1; ++i)
     {
-        if (VALID_CHARS[i] == current)
-            return VALID_CHARS[i + 1];
+        if (pgm_read_byte(&VALID_CHARS[i]) == current)
+            return pgm_read_byte(&VALID_CHARS[i + 1]);
     }
-    return VALID_CHARS[0];  // wrap around
+    return pgm_read_byte(&VALID_CHARS[0]);  // wrap around
 }
 
 // Helper: get previous valid character
@@ -133,42 +225,31 @@ char getPrevChar(char current)
 {
     for (int i = 1; i < VALID_CHARS_COUNT; ++i)
     {
-        if (VALID_CHARS[i] == current)
-            return VALID_CHARS[i - 1];
+        if (pgm_read_byte(&VALID_CHARS[i]) == current)
+            return pgm_read_byte(&VALID_CHARS[i - 1]);
     }
-    return VALID_CHARS[VALID_CHARS_COUNT - 1];  // wrap around
+    return pgm_read_byte(&VALID_CHARS[VALID_CHARS_COUNT - 1]);  // wrap around
 }
 
 // Helper: update name display on LCD while in naming mode
+// (drawn into the shadow framebuffer; only changed cells reach the LCD)
 void updateNameDisplay()
 {
-    lcd.clear();
+    fbClear();
     
     // Draw RSSI percentage on right side (top row)
-    lcd.setCursor(LCD_COLS - 3, 0);
-    if (rssiPercent < 10)
-        lcd.print("  ");
-    else if (rssiPercent < 100)
-        lcd.print(" ");
-    char buf[4];
-    sprintf(buf, "%d", rssiPercent);
-    lcd.print(buf);
-    lcd.print("%");
+    fbPrintNumber(LCD_COLS - 3, 0, 3, rssiPercent);
     
     // Draw cursor arrow and name
     if (namePos < LCD_COLS - 4)
-    {
-        lcd.setCursor(namePos, 0);
-        lcd.print("v");
-    }
+        fbPutChar(namePos, 0, 'v');
     
-    lcd.setCursor(0, 1);
     for (int i = 0; i < NAME_MAX_LEN && i < (LCD_COLS - 2); ++i)
     {
         char c = deviceName[i];
         if (c < 32)
             c = ' ';
-        lcd.print(c);
+        fbPutChar(i, 1, c);
     }
 }
 
@@ -177,597 +258,1296 @@ void saveNameToEEPROM()
 {
     for (int i = 0; i < NAME_MAX_LEN; ++i)
     {
-        EEPROM.update(NAME_EEPROM_ADDR + i, deviceName[i]);
+        hal::eepromUpdate(NAME_EEPROM_ADDR + i, deviceName[i]);
     }
 }
 
-// Start a non-blocking beep: returns immediately and stops automatically later
-void beep(unsigned int ms = BEEP_DURATION_MS, unsigned int freq = BEEP_FREQ_HZ)
+// Helper: load this unit's node ID, picking a random one on first boot
+void loadNodeId()
 {
-#ifdef QUIET_DEBUG
-    return;
-#endif
-    tone(PIN_BUZZER, freq);
-    buzzerEndTime = millis() + ms;
-    buzzerFreqActive = freq;
+    nodeId = hal::eepromRead(NODE_ID_EEPROM_ADDR);
+    if (nodeId == 0 || nodeId == 0xFF)
+    {
+        nodeId = 1 + hal::entropy() % 254;
+        hal::eepromUpdate(NODE_ID_EEPROM_ADDR, nodeId);
+    }
 }
 
-void setup()
+// Helper: best known name for a remote unit, NUL-terminated into out
+// (NAME_MAX_LEN + 1 bytes). Returns the name length, 0 if nothing is known.
+byte nodeLabel(const NodeEntry &node, char *out)
+{
+    byte len = nodeName(node, out);
+    if (len == 0 && node.id != FRAME_NODE_LEGACY)
+    {
+        memcpy_P(out, PSTR("Node "), 5);
+        len = 5 + fmtUnsigned(out + 5, node.id, 0);
+        out[len] = '\0';
+    }
+    return len;
+}
+
+#ifdef STATE_BEACONS
+// Helper: our state snapshot for the state TLV (frame.h). Button 4 held in
+// naming mode moves the cursor, it is no press.
+void ownState(Frame &f)
 {
-    // Delay to allow USB/serial monitor to connect
-    delay(2000);
+    byte held = ROLE.sendsAlerts && !namingMode ? buttonsHeld() : 0;
+    f.state = FRAME_STATE_VALID | (held & FRAME_STATE_HELD);
+    if (ownPanic)
+        f.state |= FRAME_STATE_PANIC;
+    uint16_t steps = hal::supplyMillivolts() / FRAME_BATTERY_MV;
+    f.battery = steps > 0xFF ? 0xFF : (uint8_t)steps;
+    uint8_t nameLen = frameNameLen(deviceName, NAME_MAX_LEN);
+    f.nameCheck = frameNameCheck(nameLen > 0 ? frameNameHash(deviceName, nameLen) : 0);
+}
 
-    Serial.begin(BAUD_RATE);
-    delay(500); // wait for serial monitor to be ready
+// Helper: write our current state into our frame still waiting to go out,
+// raised to prio; false if none carries the state TLV
+bool restateWaiting(byte prio)
+{
+    Frame f;
+    f.node = nodeId;
+    ownState(f);
+    return txQueueRestate(f, prio);
+}
+#endif
 
-    // Load device name from EEPROM (fixed length NAME_MAX_LEN)
-    for (int i = 0; i < NAME_MAX_LEN; ++i)
+#ifdef USE_LORA
+// Helper: encode a frame and queue it for transmit (panic/ACK > press/release >
+// beacon). A NULL name sends the name TLV only while a name announcement is pending.
+void queueFrame(Frame &f, const char *name)
+{
+#ifdef STATE_BEACONS
+    // Our beacon still waiting says the same, only older: bring it up to date
+    if (f.state != 0 && txQueueRestate(f, txPriorityFor(f.type)))
+        return;
+#endif
+    f.nameLen = 0;
+    bool announce = nameAnnounceLeft > 0 && f.node == nodeId;
+#ifdef TDMA_BEACONS
+    // Slotted beacons only take the name when taskBeacon found room for it
+    if (f.timeRoot != 0)
+        announce = false;
+#endif
+    if (name == NULL && announce)
     {
-        char c = EEPROM.read(NAME_EEPROM_ADDR + i);
-        if (c == 0xFF || c == 0)
-            c = 'a';
-        deviceName[i] = c;
+        name = deviceName;
+        --nameAnnounceLeft;
     }
-    deviceName[NAME_MAX_LEN] = '\0';
+    if (name != NULL)
+    {
+        f.nameLen = frameNameLen(name, NAME_MAX_LEN);
+        memcpy(f.name, name, f.nameLen);
+    }
+#ifdef AUTH_FRAMES
+    if (f.type == FRAME_PANIC || f.type == FRAME_ACK)
+        authSign(f);
+#endif
 
-    // Buttons
-    pinMode(PIN_BUTTON_1, INPUT_PULLUP);
-    pinMode(PIN_BUTTON_2, INPUT_PULLUP);
-    pinMode(PIN_BUTTON_3, INPUT_PULLUP);
-    pinMode(PIN_BUTTON_4, INPUT_PULLUP);
-    pinMode(PIN_BUTTON_5, INPUT_PULLUP);
+    uint8_t buf[RADIO_FRAME_MAX];
+    txQueuePush(buf, frameEncode(f, buf), txPriorityFor(f.type));
+}
 
-    // Buzzer
-    pinMode(PIN_BUZZER, OUTPUT);
-    noTone(PIN_BUZZER);
+// Helper: queue a frame without sequence number
+void sendFrame(byte type, byte button, byte node, const char *name)
+{
+    Frame f;
+    f.type = type;
+    f.node = node;
+    f.button = button;
+    f.seq = 0;
+    f.target = 0;
+    f.hops = 0;
+    f.timeRoot = 0;
+    f.authCounter = 0;
+    f.state = 0;
+#ifdef TDMA_BEACONS
+    if (type == FRAME_BEACON)
+        slotsSetTime(f, hal::millis());
+#endif
+#ifdef STATE_BEACONS
+    // The snapshot goes out while button 4 is held and when our panic
+    // started or the button was let go, otherwise with every
+    // STATE_REFRESH_BEACONS-th beacon
+    if (type == FRAME_BEACON)
+    {
+        ownState(f);
+        byte news = f.state & STATE_NEWS;
+        bool held = (news & (1 << BUTTON_SEND)) != 0;
+        if (!held && news == stateNewsSent && stateQuietBeacons++ % STATE_REFRESH_BEACONS != 0)
+            f.state = 0;
+        else
+            stateNewsSent = news;
+    }
+#endif
+#ifdef RELAY_MODE
+    // Relays tell copies of a press apart by its sequence number
+    if (type == FRAME_PRESS || type == FRAME_RELEASE)
+    {
+        if (++pressSeq == 0)
+            pressSeq = 1;
+        f.seq = pressSeq;
+    }
+#endif
+    queueFrame(f, name);
+}
 
-    // LCD init
-    Wire.begin();
-    lcd.init();
-    lcd.backlight();
-    lcd.clear();
-    lcd.setCursor(0, 0);
-    lcd.print("Wiring Test");
+// Helper: (re)send the current panic; every NAME_REFRESH_PANIC-th frame names the sender
+void sendPanicFrame()
+{
+    Frame f;
+    f.type = FRAME_PANIC;
+    f.node = nodeId;
+    f.button = 0;
+    f.seq = panicSeq;
+    f.target = 0;
+    f.hops = 0;
+    f.timeRoot = 0;
+    f.authCounter = 0;
+    f.state = 0;
+    bool withName = (panicFramesSent % NAME_REFRESH_PANIC) == 0;
+    queueFrame(f, withName ? deviceName : NULL);
+    ++panicFramesSent;
+}
 
-#ifdef USE_LORA
-    // LoRa init
-    lcd.setCursor(0, 1);
-    lcd.print("LoRa init...");
-    delay(500);
-    // Reset LoRa module (if RST pin wired)
-    pinMode(PIN_LORA_RST, OUTPUT);
-    digitalWrite(PIN_LORA_RST, HIGH);
-    delay(50);
-    digitalWrite(PIN_LORA_RST, LOW);
-    delay(50);
-    digitalWrite(PIN_LORA_RST, HIGH);
-    delay(50);
-
-    SPI.begin();
-    // Set chip select pin
-    pinMode(PIN_LORA_SS, OUTPUT);
-    digitalWrite(PIN_LORA_SS, HIGH);
-
-    // Tell the LoRa library which pins we wired (SS, RST, DIO0)
-    LoRa.setPins(PIN_LORA_SS, PIN_LORA_RST, PIN_LORA_DIO0);
-
-    // Debug: print pin mapping
-    // Initialize LoRa module
-    if (!LoRa.begin(LORA_FREQ))
-    {
-        loRaOk = false;
-        lcd.clear();
-        lcd.setCursor(0, 0);
-        lcd.print("LoRa: FAILED");
+// Helper: delay before repeating our panic: fast retries with exponential
+// back-off and jitter until a receiver acknowledged it, slow keepalives after
+unsigned long panicRetryDelay()
+{
+    if (panicAcked)
+        return PANIC_KEEPALIVE_MS;
+    unsigned long delayMs = PANIC_RETRY_MS;
+    for (byte n = 1; n < panicFramesSent && delayMs < PANIC_RETRY_MAX_MS; ++n)
+        delayMs *= 2;
+    if (delayMs > PANIC_RETRY_MAX_MS)
+        delayMs = PANIC_RETRY_MAX_MS;
+    return delayMs + hal::entropy() % PANIC_RETRY_JITTER_MS;
+}
+#endif
+
+// Helper: start the panic siren and switch the panic screen to view
+// (PANIC_VIEW_OWN or the node table slot of a remote panic)
+void showPanic(byte view)
+{
+    unsigned long now = hal::millis();
+    panicMode = true;
+    panicView = view;
+    panicViewSince = now;
+    buzzerLoop(BUZZER_SIREN);
+    schedAt(TASK_DISPLAY, now);
+}
+
+// Helper: is view (PANIC_VIEW_OWN or a node table slot) an active panic
+bool panicViewActive(byte view)
+{
+    if (view == PANIC_VIEW_OWN)
+        return ownPanic;
+    const NodeEntry *node = nodeAt(view);
+    return node != NULL && (node->state & NODE_PANIC);
+}
+
+// Helper: the active panic after view, in the order own, slot 0, 1, ...
+byte nextPanicView(byte view)
+{
+    for (byte step = 0; step <= NODE_TABLE_SLOTS; ++step)
+    {
+        if (view == PANIC_VIEW_OWN)
+            view = 0;
+        else if (++view == NODE_TABLE_SLOTS)
+            view = PANIC_VIEW_OWN;
+        if (panicViewActive(view))
+            break;
     }
-    else
+    return view;
+}
+
+#ifdef USE_LORA
+// Helper: a remote unit pressed (or still holds) button 4: show its name if
+// known and beep
+void remotePress(NodeEntry &node, unsigned long now)
+{
+    char name[NAME_MAX_LEN + 1];
+    byte nameLen = nodeLabel(node, name);
+    if (nameLen > 0)
     {
-        loRaOk = true;
-        // Optimize for 2km range with responsive beeps
-        LoRa.setTxPower(20);              // Max power (0-20 dBm)
-        LoRa.setSignalBandwidth(125E3);   // 125kHz bandwidth for maximum range
-        LoRa.setSpreadingFactor(12);      // SF12 for maximum range (~1.5s per packet)
-        LoRa.setCodingRate4(8);           // 4/8 coding for error correction
-        lcd.clear();
+        // Replace row 0 with the name (truncated to LCD_COLS)
+        fbClearRow(0);
+        fbPrintN(0, 0, name, nameLen);
     }
-#else
-    lcd.setCursor(0, 0);
-    lcd.print("LoRa: disabled ");
-#endif
+    // Beep on any press packet (with or without name)
+    buzzerPlay(BUZZER_BEEP);
+    node.state |= NODE_PRESSING;
+    if (!schedArmed(TASK_RX_TIMEOUT))
+        schedIn(TASK_RX_TIMEOUT, now, RECEIVE_TIMEOUT_MS + 1);
+}
 
-    delay(500);
+// Helper: a remote unit let go of button 4: clear the name row
+void remoteRelease(NodeEntry &node)
+{
+    fbClearRow(0);
+    node.state &= ~NODE_PRESSING;
 }
 
-void loop()
+#ifdef STATE_BEACONS
+// Helper: bring what we know of a remote unit in line with its state
+// snapshot, making up for a press, release or panic frame we missed
+void applyState(const Frame &f, NodeEntry &node, unsigned long now)
 {
-    // Read buttons and update LCD and buzzer when presses detected
-    const int buttonPins[5] = {PIN_BUTTON_1, PIN_BUTTON_2, PIN_BUTTON_3, PIN_BUTTON_4, PIN_BUTTON_5};
-    for (int i = 0; i < 5; ++i)
+    node.state |= NODE_SENDS_STATE;
+    node.battery = f.battery;
+    // Renamed since we stored its name: show its ID until the new one is announced
+    if (node.nameHash != 0 && frameNameCheck(node.nameHash) != f.nameCheck)
+        nodeForgetName(node);
+    if (!ROLE.receivesAlerts)
+        return;
+
+    bool held = (f.state & (1 << BUTTON_SEND)) != 0;
+    if (held && !(node.state & NODE_PRESSING))
+        remotePress(node, now);
+    else if (!held && (node.state & NODE_PRESSING))
+        remoteRelease(node);
+#ifndef AUTH_FRAMES
+    // Show its panic now rather than at the next keepalive. With AUTH_FRAMES
+    // only a signed panic frame may raise one, and beacons are not signed.
+    if ((f.state & FRAME_STATE_PANIC) && !(node.state & NODE_PANIC))
     {
-        int reading = digitalRead(buttonPins[i]);
+        node.state |= NODE_PANIC;
+        node.panicSeq = 0;
+        recordEvent(JOURNAL_PANIC_HEARD, f.node, node.rssi, 0, now);
+        showPanic(nodeSlot(node));
+        buzzerPlay(BUZZER_BEEP);
+    }
+#endif
+}
+#endif
+
+// Helper: act on one decoded frame of len bytes from the air, received at rssi dBm
+void handleFrame(const Frame &f, uint8_t len, int rssi)
+{
+    unsigned long now = hal::millis();
+
+    // Our own frame echoed back
+    if (f.node == nodeId)
+        return;
+
+#ifdef AUTH_FRAMES
+    // Panics and ACKs only count (and are only relayed) with a valid tag and
+    // a counter above the last one accepted from the sender. Copies of that
+    // last one still in the duplicate cache go on to be told apart below.
+    bool signedType = f.type == FRAME_PANIC || f.type == FRAME_ACK;
+    if (signedType && !authCheck(f, nodeFind(f.node), f.seq != 0 && relaySeen(f, now)))
+        return;
+#endif
 
-        // If the reading changed from last time, reset the debounce timer
-        if (reading != lastReading[i])
+    // Copies of a frame with a sequence number arrive directly and over
+    // relays: act on (and relay) the first one only. Panic copies still get
+    // through so each is acknowledged; the panic branch ignores repeats. With
+    // AUTH_FRAMES a copy heard after the cache forgot the panic is refused
+    // above as a replay.
+    if (f.seq != 0)
+    {
+        if (relayFirstSeen(f, now))
         {
-            lastDebounce[i] = millis();
-            lastReading[i] = reading;
+#ifdef RELAY_MODE
+            if (f.type != FRAME_ACK || f.target != nodeId)
+                relayForward(f);
+#endif
         }
+        else if (f.type != FRAME_PANIC)
+            return;
+    }
+
+    // Track the sender; the RSSI says something about it only when heard
+    // directly. Announced names label its later 2-byte frames.
+    NodeEntry &node = nodeTouch(f.node, now);
+    if (f.hops == 0)
+        node.rssi = rssi < -128 ? -128 : rssi;
+    if (f.nameLen > 0)
+        nodeSetName(node, f.name, f.nameLen);
+#ifdef AUTH_FRAMES
+    if (signedType)
+        authAccepted(f, node);
+#endif
+#ifdef STATE_BEACONS
+    if (f.state != 0)
+        applyState(f, node, now);
+#endif
 
-        // If the reading has been stable for longer than the debounce interval,
-        // and it's different from the last stable state, we have a confirmed change.
-        if ((millis() - lastDebounce[i]) > DEBOUNCE_MS && reading != stableState[i])
+    // Beacons are silent test packets; slotted ones keep our superframe in step
+    if (f.type == FRAME_BEACON)
+    {
+#ifdef TDMA_BEACONS
+        if (slotsHeard(f, len, now))
+            schedAt(TASK_BEACON, slotsNextBeaconAt(now));
+#endif
+    }
+    // The others' alerts, unless we are a sender or relay only
+    else if (ROLE.receivesAlerts && f.type == FRAME_BEEP)
+    {
+        buzzerPlay(BUZZER_BEEP);
+    }
+    else if (ROLE.receivesAlerts && f.type == FRAME_PANIC)
+    {
+        // Acknowledge every copy, ours may have been lost
+        if (f.seq != 0 && f.node != FRAME_NODE_LEGACY)
         {
-            stableState[i] = reading;
-            // record press start for long-press detection
-            if (stableState[i] == LOW)
-            {
-                pressStart[i] = millis();
-                longPressHandled[i] = false;
-            }
+            ackNode = f.node;
+            ackSeq = f.seq;
+            schedIn(TASK_SEND_ACK, now, hal::entropy() % ACK_JITTER_MS);
+        }
+        // Add it to the panics on screen and show it first, unless this is
+        // a repeat of a panic we already have from that node
+        bool repeat = (node.state & NODE_PANIC) && f.seq != 0 && node.panicSeq == f.seq;
+        if (!repeat)
+        {
+            node.state |= NODE_PANIC;
+            node.panicSeq = f.seq;
+            recordEvent(JOURNAL_PANIC_HEARD, f.node, node.rssi, f.seq, now);
+            showPanic(nodeSlot(node));
+            buzzerPlay(BUZZER_BEEP);
+        }
+    }
+    // A receiver got our panic: slow down to keepalives and show "DELIVERED"
+    else if (ROLE.sendsAlerts && f.type == FRAME_ACK)
+    {
+        if (f.target == nodeId && ownPanic && f.seq == panicSeq && !panicAcked)
+        {
+            panicAcked = true;
+            panicAckLatency = now - panicStartedAt;
+            recordEvent(JOURNAL_PANIC_ACKED, f.node, rssi, f.seq, now);
+            schedIn(TASK_PANIC_RESEND, now, PANIC_KEEPALIVE_MS);
+            schedAt(TASK_DISPLAY, now);
+            buzzerPlay(BUZZER_CHIRP);
+        }
+    }
+    // Only button 4 transmits presses
+    else if (ROLE.receivesAlerts && f.type == FRAME_PRESS)
+    {
+        remotePress(node, now);
+    }
+    else if (ROLE.receivesAlerts && f.type == FRAME_RELEASE)
+    {
+        remoteRelease(node);
+    }
+}
+#endif
+
+// Helper: a debounced press of button i (0-based)
+void onButtonPress(byte i)
+{
+    // If in naming mode, map buttons to name editing
+    if (namingMode)
+    {
+        if (i == 0)
+        { // button1 decrease char (to previous valid character)
+            char &ch = deviceName[namePos];
+            ch = getPrevChar(ch);
+            updateNameDisplay();
+            buzzerPlay(BUZZER_BEEP);
+        }
+        else if (i == 1)
+        { // button2 increase char (to next valid character)
+            char &ch = deviceName[namePos];
+            ch = getNextChar(ch);
+            updateNameDisplay();
+            buzzerPlay(BUZZER_BEEP);
+        }
+        else if (i == 2)
+        { // button3 move cursor back
+            if (namePos > 0)
+                namePos--;
             else
-            {
-                pressStart[i] = 0;
-                longPressHandled[i] = false;
-            }
-            // Confirmed state change
-            if (stableState[i] == LOW)
-            { // pressed (active LOW)
-                Serial.print("Button ");
-                Serial.print(i + 1);
-                Serial.println(" pressed");
-                // If in naming mode, map buttons to name editing
-                if (namingMode)
-                {
-                    if (i == 0)
-                    { // button1 decrease char (to previous valid character)
-                        char &ch = deviceName[namePos];
-                        ch = getPrevChar(ch);
-                        updateNameDisplay();
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    else if (i == 1)
-                    { // button2 increase char (to next valid character)
-                        char &ch = deviceName[namePos];
-                        ch = getNextChar(ch);
-                        updateNameDisplay();
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    else if (i == 2)
-                    { // button3 move cursor back
-                        if (namePos > 0)
-                            namePos--;
-                        else
-                            namePos = NAME_MAX_LEN - 1;
-                        updateNameDisplay();
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    else if (i == 3)
-                    { // button4 move cursor forward
-                        namePos++;
-                        if (namePos >= NAME_MAX_LEN)
-                            namePos = 0;
-                        updateNameDisplay();
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                }
-                else
-                {
-                    // Don't display buttons 1-3 locally, only button 5 (panic)
-                    if (i == 3)
-                    {
-                        // button 4: just beep, don't display
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    else if (i == 4)
-                    {
-                        // button 5: trigger panic mode
-                        panicMode = true;
-                        memcpy(panicName, deviceName, NAME_MAX_LEN + 1);
-                        panicBeepLastTime = 0;
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    else
-                    {
-                        // buttons 1-3: just beep
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    
-// send press only if not in naming mode
+                namePos = NAME_MAX_LEN - 1;
+            updateNameDisplay();
+            buzzerPlay(BUZZER_BEEP);
+        }
+        else if (i == 3)
+        { // button4 move cursor forward
+            namePos++;
+            if (namePos >= NAME_MAX_LEN)
+                namePos = 0;
+            updateNameDisplay();
+            buzzerPlay(BUZZER_BEEP);
+        }
+    }
+    else
+    {
+        // Don't display buttons 1-3 locally, only button 5 (panic)
+        if (i == BUTTON_SEND)
+        {
+            // button 4: just beep, don't display
+            buzzerPlay(BUZZER_BEEP);
+        }
+        else if (ROLE.sendsAlerts && i == BUTTON_PANIC)
+        {
+            // button 5: trigger panic mode. Once the radio is up the alert is
+            // handed to it (or its channel check started) before the journal
+            // and the LCD are updated; during boot it waits in the queue.
+            if (++panicSeq == 0)
+                panicSeq = 1;
+            ownPanic = true;
+            panicFramesSent = 0;
+            panicAcked = false;
+            panicStartedAt = hal::millis();
 #ifdef USE_LORA
-                    if (loRaOk && i == 3)
-                    {
-                        // Send device name with button 4 (for reference)
-                        // Only button 4 (index 3) transmits. Build C-string without using Arduino String.
-                        char out[NAME_MAX_LEN + 4]; // 'P' + digit + optional '|' + name + NUL
-                        int pos = 0;
-                        out[pos++] = 'P';
-                        out[pos++] = (char)('1' + i);
-                        out[pos] = '\0';
-
-                        // Trim trailing spaces from deviceName
-                        const char *namePtr = deviceName;
-                        size_t len = strlen(namePtr);
-                        while (len > 0 && namePtr[len - 1] == ' ')
-                            --len;
-
-                        if (len > 0)
-                        {
-                            out[pos++] = '|';
-                            memcpy(out + pos, namePtr, len);
-                            pos += len;
-                        }
-                        out[pos] = '\0';
-
-                        LoRa.beginPacket();
-                        LoRa.print(out);
-                        LoRa.endPacket(true);  // Non-blocking
-                        lastHoldSend[i] = millis();
-                    }
-                    else if (loRaOk && i == 4)
-                    {
-                        // Send panic signal with name to other unit
-                        char panicMsg[NAME_MAX_LEN + 3]; // 'X' + '|' + name
-                        int pos = 0;
-                        panicMsg[pos++] = 'X';  // X = panic
-                        panicMsg[pos++] = '|';
-                        
-                        const char *namePtr = deviceName;
-                        size_t len = strlen(namePtr);
-                        while (len > 0 && namePtr[len - 1] == ' ')
-                            --len;
-                        
-                        if (len > 0)
-                        {
-                            memcpy(panicMsg + pos, namePtr, len);
-                            pos += len;
-                        }
-                        panicMsg[pos] = '\0';
-                        
-                        LoRa.beginPacket();
-                        LoRa.print(panicMsg);
-                        LoRa.endPacket(true);  // Non-blocking
-                    }
-#endif
-                }
+            if (radioUsable())
+            {
+                sendPanicFrame();
+                if (loRaOk)
+                    txQueueService(panicStartedAt);
+                schedIn(TASK_PANIC_RESEND, hal::millis(), panicRetryDelay());
             }
-            else
-            { // released
-                // If in naming mode, do not send release; handle long-press saving elsewhere
-                if (!namingMode)
-                {
-                    // Don't display button releases on LCD
+#endif
+            recordEvent(JOURNAL_PANIC_SENT, nodeId, 0, panicSeq, panicStartedAt);
+            showPanic(PANIC_VIEW_OWN);
+            buzzerPlay(BUZZER_BEEP);
+        }
+        else
+        {
+            // buttons 1-3: just beep
+            buzzerPlay(BUZZER_BEEP);
+        }
+
+        // send press only if not in naming mode
 #ifdef USE_LORA
-                    if (loRaOk && i == 3)
-                    {
-                        char out[4] = {'R', (char)('1' + i), '\0'};
-                        LoRa.beginPacket();
-                        LoRa.print(out);
-                        LoRa.endPacket(true);  // Non-blocking
-                        lastHoldSend[i] = 0;
-                    }
-#endif
-                }
-            }
+        if (ROLE.sendsAlerts && radioUsable() && i == BUTTON_SEND)
+        {
+            // Only button 4 transmits; the name goes out only while announcing
+            sendFrame(FRAME_PRESS, i, nodeId, NULL);
+            schedIn(TASK_HOLD_RESEND, hal::millis(), HOLD_RESEND_MS);
         }
+#endif
+    }
+
+    if (LOG_ON(LOG_INFO))
+    {
+        logText_P(PSTR("Button "));
+        logNumber(i + 1);
+        logText_P(PSTR(" pressed"));
+        logEnd();
     }
+#ifdef TELEMETRY
+    telEvent(TEL_EVENT_BUTTON_DOWN, nodeId, 0, i, hal::millis());
+#endif
+}
 
-    // Handle long-press actions (enter/exit naming mode when button3 is held)
-    for (int i = 0; i < 5; ++i)
+// Helper: a debounced release of button i
+void onButtonRelease(byte i)
+{
+    // If in naming mode, do not send release; handle long-press saving elsewhere
+    if (!namingMode)
     {
-        if (stableState[i] == LOW && pressStart[i] != 0 && !longPressHandled[i])
+        // Don't display button releases on LCD
+#ifdef USE_LORA
+        if (ROLE.sendsAlerts && radioUsable() && i == BUTTON_SEND)
         {
-            if ((millis() - pressStart[i]) >= LONG_PRESS_MS)
-            {
-                // long-press detected
-                longPressHandled[i] = true;
-                if (i == 2)
-                { // button3 long-press
-                    if (!namingMode)
-                    {
-                        // enter naming mode
-                        namingMode = true;
-                        namePos = 0;
-                        updateNameDisplay();
-                    }
-                    else
-                    {
-                        // save name and exit naming mode
-                        saveNameToEEPROM();
-                        namingMode = false;
-                        lcd.clear();
-                        lcd.setCursor(0, 0);
-                        lcd.print("Name saved");
-                        delay(600);
-                        lcd.clear();
-                    }
-                }
-                else if (i == 3 && namingMode)
-                { // button4 long-press in naming mode: clear name
-                    // Fill name with spaces and reset cursor to position 0
-                    for (int j = 0; j < NAME_MAX_LEN; ++j)
-                        deviceName[j] = ' ';
-                    namePos = 0;
-                    updateNameDisplay();
-                    beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                }
-            }
+#ifdef STATE_BEACONS
+            // Our beacon still waiting tells the release, as soon as a release would
+            if (!restateWaiting(TX_PRIO_PRESS))
+#endif
+                sendFrame(FRAME_RELEASE, i, nodeId, NULL);
+            schedStop(TASK_HOLD_RESEND);
         }
+#endif
     }
+#ifdef TELEMETRY
+    telEvent(TEL_EVENT_BUTTON_UP, nodeId, 0, i, hal::millis());
+#endif
+}
 
-    // Check for incoming LoRa packets (non-blocking)
-#ifdef USE_LORA
-    if (loRaOk)
+// Helper: button i has been held for LONG_PRESS_MS
+// (enter/exit naming mode when button3 is held)
+void onButtonLongPress(byte i)
+{
+    if (i == BUTTON_NAME)
+    { // button3 long-press
+        if (!namingMode)
+        {
+            // enter naming mode
+            namingMode = true;
+            namePos = 0;
+            updateNameDisplay();
+        }
+        else
+        {
+            // save name and exit naming mode
+            saveNameToEEPROM();
+            nameAnnounceLeft = NAME_ANNOUNCE_FRAMES;
+            namingMode = false;
+            fbClear();
+            fbPrint_P(0, 0, PSTR("Name saved"));
+            schedIn(TASK_MESSAGE, hal::millis(), MESSAGE_MS);
+        }
+    }
+    else if (i == 3 && namingMode)
+    { // button4 long-press in naming mode: clear name
+        // Fill name with spaces and reset cursor to position 0
+        for (int j = 0; j < NAME_MAX_LEN; ++j)
+            deviceName[j] = ' ';
+        namePos = 0;
+        updateNameDisplay();
+        buzzerPlay(BUZZER_BEEP);
+    }
+}
+
+// Task: sample/debounce all buttons at once; act on press, release and long-press events
+void taskButtons(uint32_t now)
+{
+    PROF_BEGIN(t);
+    ButtonEvent events[BUTTON_COUNT];
+    byte eventCount = buttonsPoll(now, events);
+    for (byte e = 0; e < eventCount; ++e)
     {
-        int packetSize = LoRa.parsePacket();
-        if (packetSize)
+        if (events[e].type == BUTTON_PRESS)
         {
-            // Read entire packet into a char buffer
-            char payload[64] = {0}; // fixed-size buffer for received packet
-            int payloadLen = 0;
-            while (LoRa.available() && payloadLen < (int)sizeof(payload) - 1)
-            {
-                payload[payloadLen++] = (char)LoRa.read();
-            }
-            payload[payloadLen] = '\0'; // null-terminate
-            
-            // Update RSSI display
-            int rssi = LoRa.packetRssi();
-            updateRssiDisplay(rssi);
-            
-            if (payloadLen > 0)
-            {
-                unsigned long now = millis();
-                
-                // Skip test packets
-                if (!(payloadLen == 2 && payload[0] == 'T' && payload[1] == 'X'))
-                {
-                    // Check for beep command
-                    if (payloadLen == 1 && payload[0] == 'B')
-                    {
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                    }
-                    // Check for panic signal (format: X|name)
-                    else if (payloadLen > 1 && payload[0] == 'X')
-                    {
-                        const char *pipePos = strchr(payload, '|');
-                        if (pipePos != NULL && pipePos + 1 < payload + payloadLen)
-                        {
-                            const char *nameStart = pipePos + 1;
-                            int nameLen = payloadLen - (nameStart - payload);
-                            // Enter panic mode with remote device name
-                            panicMode = true;
-                            memset(panicName, 0, NAME_MAX_LEN + 1);
-                            if (nameLen > NAME_MAX_LEN)
-                                nameLen = NAME_MAX_LEN;
-                            memcpy(panicName, nameStart, nameLen);
-                            panicBeepLastTime = 0;  // trigger immediate beep
-                            beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                        }
-                    }
-                    // Only process button 4 name transmissions (format: P4 or P4|name)
-                    else if (payloadLen > 1 && payload[0] == 'P')
-                    {
-                        const char *pipePos = strchr(payload, '|');
-                        if (pipePos != NULL && pipePos + 1 < payload + payloadLen)
-                        {
-                            const char *nameStart = pipePos + 1;
-                            int nameLen = payloadLen - (nameStart - payload);
-                            // Clear row 0 first
-                            lcd.setCursor(0, 0);
-                            for (int p = 0; p < LCD_COLS; ++p)
-                                lcd.print(' ');
-                            // Print name (truncate to LCD_COLS if necessary)
-                            lcd.setCursor(0, 0);
-                            for (int p = 0; p < nameLen && p < LCD_COLS; ++p)
-                                lcd.print(nameStart[p]);
-                        }
-                        // Beep on any P4 packet (with or without name)
-                        beep(BEEP_DURATION_MS, BEEP_FREQ_HZ);
-                        lastReceivedAt[3] = now;
-                    }
-                    // Check for release (R# clears the name)
-                    else if (payloadLen >= 2 && payload[0] == 'R')
-                    {
-                        // Clear name row on release
-                        lcd.setCursor(0, 0);
-                        for (int p = 0; p < LCD_COLS; ++p)
-                            lcd.print(' ');
-                        lastReceivedAt[3] = 0;
-                    }
-                }
-            }
+#ifdef USE_PROFILER
+            // Press-to-transmit of a panic counts from the contact edge
+            if (events[e].button == BUTTON_PANIC && !namingMode)
+                profPressAt(hal::micros() - (uint16_t)((uint16_t)hal::millis() - events[e].atMs) * 1000UL);
+#endif
+            onButtonPress(events[e].button);
+        }
+        else if (events[e].type == BUTTON_RELEASE)
+            onButtonRelease(events[e].button);
+        else
+        {
+            PROF_BEGIN(l);
+            onButtonLongPress(events[e].button);
+            PROF_END(PROF_LONG_PRESS, l);
         }
     }
-#endif    // Handle panic mode display and beeping
+    PROF_END(PROF_BUTTONS, t);
+}
+
+// Task: redraw the panic screen, or signal strength on the main idle screen
+// (nothing while naming). Only touches the shadow; unchanged cells cost no I2C.
+void taskDisplay(uint32_t now)
+{
+    // A message screen stays up until TASK_MESSAGE, unless a panic comes in
+    if (namingMode || (!panicMode && schedArmed(TASK_MESSAGE)))
+        return;
+
+    PROF_BEGIN(t);
     if (panicMode)
     {
-        unsigned long now = millis();
-        
-        // Display panic mode on LCD with RSSI % on right
-        lcd.setCursor(LCD_COLS - 3, 0);
-        if (rssiPercent < 10)
-            lcd.print("  ");
-        else if (rssiPercent < 100)
-            lcd.print(" ");
-        char buf[4];
-        sprintf(buf, "%d", rssiPercent);
-        lcd.print(buf);
-        lcd.print("%");
-        
-        // Display name on top row (left side)
-        const char *name = panicName;
-        size_t nameLen = strlen(name);
-        lcd.setCursor(0, 0);
-        if (nameLen > 0)
+        // Next active panic every PANIC_CYCLE_MS
+        if (!panicViewActive(panicView) || now - panicViewSince >= PANIC_CYCLE_MS)
         {
-            for (int p = 0; p < (int)nameLen && p < (LCD_COLS - 5); ++p)
-                lcd.print(name[p]);
+            panicView = nextPanicView(panicView);
+            panicViewSince = now;
         }
-        
-        // Display "PANIC" on bottom row (left side)
-        lcd.setCursor(0, 1);
-        lcd.print("PANIC");
-        
-        // Rapid beeping every PANIC_BEEP_INTERVAL ms
-        if (now - panicBeepLastTime >= PANIC_BEEP_INTERVAL)
+
+        // Name on top row (left side) with its RSSI % on the right
+        char name[NAME_MAX_LEN + 1];
+        byte rssi = rssiPercent;
+        NodeEntry *node = panicView == PANIC_VIEW_OWN ? NULL : nodeAt(panicView);
+        if (node != NULL)
         {
-            panicBeepState = !panicBeepState;
-            if (panicBeepState)
-            {
-                tone(PIN_BUZZER, BEEP_FREQ_HZ);
-            }
-            else
-            {
-                noTone(PIN_BUZZER);
-            }
-            panicBeepLastTime = now;
+            nodeLabel(*node, name);
+            rssi = rssiToPercent(node->rssi);
         }
-        
-        // Resend panic signal periodically to other unit
-#ifdef USE_LORA
-        static unsigned long lastPanicSent = 0;
-        if (loRaOk && (lastPanicSent == 0 || (now - lastPanicSent) >= 500))
+        else
+            memcpy(name, deviceName, NAME_MAX_LEN + 1);
+        byte nameLen = frameNameLen(name, LCD_COLS - 5);
+        fbPrintN(0, 0, name, nameLen);
+        for (byte p = nameLen; p < LCD_COLS - 5; ++p)
+            fbPutChar(p, 0, ' ');
+        fbPrintNumber(LCD_COLS - 3, 0, 3, rssi);
+
+        // "PANIC" on bottom row, whether a receiver acknowledged ours, and
+        // which of several panics this is
+        bool delivered = panicView == PANIC_VIEW_OWN && panicAcked;
+        fbPrint_P(0, 1, delivered ? PSTR("PANIC DELIVERED ") : PSTR("PANIC           "));
+        byte total = ownPanic ? 1 : 0;
+        byte position = total;
+        for (byte i = 0; i < NODE_TABLE_SLOTS; ++i)
         {
-            char panicMsg[NAME_MAX_LEN + 3];
-            int pos = 0;
-            panicMsg[pos++] = 'X';
-            panicMsg[pos++] = '|';
-            
-            const char *namePtr = panicName;
-            size_t len = strlen(namePtr);
-            while (len > 0 && namePtr[len - 1] == ' ')
-                --len;
-            
-            if (len > 0)
+            if (panicViewActive(i))
             {
-                memcpy(panicMsg + pos, namePtr, len);
-                pos += len;
+                ++total;
+                if (i == panicView)
+                    position = total;
             }
-            panicMsg[pos] = '\0';
-            
-            LoRa.beginPacket();
-            LoRa.print(panicMsg);
-            LoRa.endPacket(true);  // Non-blocking
-            lastPanicSent = now;
         }
-#endif
-       
+        if (total > 1 && !delivered)
+        {
+            fbPutChar(LCD_COLS - 3, 1, '0' + position);
+            fbPutChar(LCD_COLS - 2, 1, '/');
+            fbPutChar(LCD_COLS - 1, 1, '0' + total);
+        }
+        PROF_END(PROF_PANIC_RENDER, t);
+    }
+    else
+    {
+        // RSSI % on top right
+        fbPrintNumber(LCD_COLS - 3, 0, 3, rssiPercent);
+
+        // Display time since last signal on bottom right (tenths of a second, capped at 999)
+        unsigned long timeSinceLastSignal = (now - lastRssiUpdate) / 100;
+        fbPrintNumber(LCD_COLS - 3, 1, 3, timeSinceLastSignal);
+        PROF_END(PROF_IDLE_RENDER, t);
     }
+}
+
+// Task: push whatever changed on screen (rate-limited by fbFlush itself)
+void taskLcdFlush(uint32_t now)
+{
+    PROF_BEGIN(t);
+    fbFlush(now);
+    PROF_END(PROF_LCD_FLUSH, t);
+}
+
+// Task: a message screen has been up for MESSAGE_MS, back to the idle screen
+void taskMessage(uint32_t now)
+{
+    (void)now;
+    if (!panicMode && !namingMode)
+        fbClear();
+}
+
+// Task: reset RSSI to 0 if no packets received for RSSI_TIMEOUT
+void taskRssiTimeout(uint32_t now)
+{
+    rssiPercent = 0;
+    linkUp = false;
+    recordEvent(JOURNAL_LINK_LOST, 0, 0, 0, now);
+}
 
-    // Resend 'P#' periodically while a local button is held (improves reliability)
 #ifdef USE_LORA
-    if (loRaOk)
+// Task: resend our panic signal until acknowledged, then as keepalive
+void taskPanicResend(uint32_t now)
+{
+    if (!ownPanic)
+        return;
+    sendPanicFrame();
+    schedIn(TASK_PANIC_RESEND, now, panicRetryDelay());
+}
+
+// Task: acknowledge the last panic received
+void taskSendAck(uint32_t now)
+{
+    Frame f;
+    f.type = FRAME_ACK;
+    f.node = nodeId;
+    f.button = 0;
+    f.seq = ackSeq;
+    f.target = ackNode;
+    f.hops = 0;
+    f.timeRoot = 0;
+    f.authCounter = 0;
+    f.state = 0;
+    queueFrame(f, NULL);
+}
+
+// Task: transmit every 5 seconds for signal testing (reduce collisions with button presses),
+// or with TDMA_BEACONS once per superframe in our slot
+void taskBeacon(uint32_t now)
+{
+    // Silent test packet, won't trigger beep/display; periodically names us for late joiners.
+    // With STATE_BEACONS it may carry our state snapshot, see sendFrame().
+    bool withName = (beaconCount++ % NAME_REFRESH_BEACONS) == 0;
+#ifdef TDMA_BEACONS
+    // A named beacon runs into the next slot: wait for a superframe where that one is free
+    if (withName && !slotsRoomForName(frameNameLen(deviceName, NAME_MAX_LEN)))
+    {
+        withName = false;
+        --beaconCount;
+    }
+    schedAt(TASK_BEACON, slotsNextBeaconAt(now));
+#endif
+    sendFrame(FRAME_BEACON, 0, nodeId, withName ? deviceName : NULL);
+}
+
+// Task: resend 'P4' periodically while button 4 is held (improves reliability).
+// With STATE_BEACONS a state beacon says it is still held, and stands in for
+// the next periodic beacon.
+void taskHoldResend(uint32_t now)
+{
+    if (!(buttonsHeld() & (1 << BUTTON_SEND)))
+    {
+        schedStop(TASK_HOLD_RESEND);
+        return;
+    }
+#ifdef STATE_BEACONS
+    if (!restateWaiting(TX_PRIO_BEACON))
+        sendFrame(FRAME_BEACON, 0, nodeId, NULL);
+    if (schedArmed(TASK_BEACON))
+        schedIn(TASK_BEACON, now, BEACON_INTERVAL_MS);
+#else
+    sendFrame(FRAME_PRESS, BUTTON_SEND, nodeId, NULL);
+#endif
+}
+
+// Task: end remote presses that timed out (no hold resend or release heard)
+void taskRxTimeout(uint32_t now)
+{
+    bool pending = false;
+    unsigned long nextDue = 0;
+    for (byte i = 0; i < NODE_TABLE_SLOTS; ++i)
     {
-        // Stop buzzer if time expired (non-blocking beep)
-        if (buzzerEndTime != 0 && millis() >= buzzerEndTime)
+        NodeEntry *node = nodeAt(i);
+        if (node == NULL || !(node->state & NODE_PRESSING))
+            continue;
+        unsigned long due = node->lastSeen + RECEIVE_TIMEOUT_MS + 1;
+#ifdef STATE_BEACONS
+        // Its presses are refreshed by state beacons, further apart
+        if (node->state & NODE_SENDS_STATE)
+            due = node->lastSeen + HOLD_REFRESH_TIMEOUT_MS + 1;
+#endif
+        if ((long)(now - due) >= 0)
         {
-            noTone(PIN_BUZZER);
-            buzzerEndTime = 0;
-            buzzerFreqActive = 0;
+            node->state &= ~NODE_PRESSING;
+            // Only button 4 transmits presses: mark it and clear the name row
+            fbPutChar(3, 1, '-');
+            fbClearRow(0);
         }
-        unsigned long now = millis();
-        
-        // Transmit constantly every 5 seconds for signal testing (reduce collisions with button presses)
-        static unsigned long lastConstantTx = 0;
-        if (lastConstantTx == 0 || (now - lastConstantTx) >= 5000)
+        else if (!pending || (long)(due - nextDue) < 0)
         {
-            char out[3] = {'T', 'X', '\0'};  // Silent test packet, won't trigger beep/display
-            LoRa.beginPacket();
-            LoRa.print(out);
-            LoRa.endPacket(true);  // Non-blocking
-            lastConstantTx = now;
+            pending = true;
+            nextDue = due;
         }
-        
-        // Only resend for button 4 (index 3) if held
-        if (stableState[3] == LOW)
+    }
+    if (pending)
+        schedAt(TASK_RX_TIMEOUT, nextDue);
+}
+#endif
+
+#ifdef BATTERY_MODE
+// Helper: end of a loop() pass in battery mode. While anything is going on
+// (or for BATTERY_LISTEN_MS after) the unit stays awake with the radio in
+// receive. Otherwise the UI tasks stop, the radio sleeps and the MCU powers
+// down, waking every BATTERY_CAD_PERIOD_MS to sniff for a preamble.
+void batteryService(unsigned long now)
+{
+    bool busy = panicMode || namingMode || !buttonsIdle() || rxQueueReceived() != batteryRxSeen ||
+                txQueueDepth() > 0 || hal::radioBusy() || buzzerSounding() ||
+                schedArmed(TASK_SEND_ACK) || schedArmed(TASK_HOLD_RESEND) || schedArmed(TASK_RX_TIMEOUT);
+    batteryRxSeen = rxQueueReceived();
+    if (busy)
+        listenUntil = now + BATTERY_LISTEN_MS;
+
+    if ((long)(now - listenUntil) < 0)
+    {
+        if (radioState != RADIO_LISTEN)
         {
+            hal::radioReceive();
+            radioState = RADIO_LISTEN;
+            hal::lcdBacklight(true);
+            schedAt(TASK_BUTTONS, now);
+            schedAt(TASK_DISPLAY, now);
+            schedAt(TASK_LCD_FLUSH, now);
+        }
+        if (schedIdle(now))
+            hal::idle();
+        return;
+    }
 
-            if (lastHoldSend[3] == 0 || (now - lastHoldSend[3]) >= HOLD_SEND_INTERVAL_MS)
-            {
-                // Build C-string packet for hold-resend
-                char out[NAME_MAX_LEN + 4] = {0};
-                int pos = 0;
-                out[pos++] = 'P';
-                out[pos++] = '4';
-
-                // Trim trailing spaces from deviceName
-                const char *namePtr = deviceName;
-                size_t len = strlen(namePtr);
-                while (len > 0 && namePtr[len - 1] == ' ')
-                    --len;
-
-                if (len > 0)
-                {
-                    out[pos++] = '|';
-                    memcpy(out + pos, namePtr, len);
-                    pos += len;
-                }
-                out[pos] = '\0';
-
-                LoRa.beginPacket();
-                LoRa.print(out);
-                LoRa.endPacket(true);  // Non-blocking
-                lastHoldSend[3] = now;
-            }
+    if (radioState == RADIO_LISTEN)
+    {
+        // Quiet: leave the screen as it is, dark, and stop the radio
+        fbFlushAll();
+        hal::lcdBacklight(false);
+        schedStop(TASK_BUTTONS);
+        schedStop(TASK_DISPLAY);
+        schedStop(TASK_LCD_FLUSH);
+        hal::radioSleep();
+        radioState = RADIO_ASLEEP;
+        sniffAt = now + BATTERY_CAD_PERIOD_MS;
+    }
+    else if (radioState == RADIO_SNIFF)
+    {
+        int8_t heard = hal::radioSniffResult();
+        if (heard < 0)
+        {
+            hal::idle(); // CAD takes about two symbols, Timer0 keeps ticking
+            return;
         }
+        if (heard > 0)
+        {
+            // Receive the rest of the preamble and the frame from the next pass
+            ++batteryWakeups;
+            listenUntil = now + BATTERY_LISTEN_MS;
+            return;
+        }
+        hal::radioSleep();
+        radioState = RADIO_ASLEEP;
+        sniffAt = now + BATTERY_CAD_PERIOD_MS;
+    }
+
+    if ((long)(now - sniffAt) >= 0)
+    {
+        ++batterySniffs;
+        hal::radioSniff();
+        radioState = RADIO_SNIFF;
+        return;
+    }
+    // Journal and name bytes still go out with the clock running
+    if (journalPending() || nodeTablePending())
+    {
+        hal::idle();
+        return;
+    }
+    uint32_t sleepMs = sniffAt - now;
+    uint32_t dueMs = schedDueIn(now);
+    hal::powerDown(dueMs < sleepMs ? dueMs : sleepMs);
+}
+#endif
+
+// Helper: ms from reset until the buttons, the radio and the LCD were ready
+void printBootTimes()
+{
+    hal::serialPrint_P(PSTR("boot ms: buttons "));
+    hal::serialPrint((long)bootButtonsMs);
+#ifdef USE_LORA
+    hal::serialPrint_P(loRaOk ? PSTR(" radio ") : PSTR(" radio failed "));
+    hal::serialPrint((long)bootRadioMs);
+#endif
+    hal::serialPrint_P(PSTR(" lcd "));
+    hal::serialPrint((long)bootLcdMs);
+    hal::serialPrintln_P(PSTR(""));
+}
+
+// Helper: dump runtime counters over serial
+void printStats()
+{
+    printBootTimes();
+#ifdef STATS
+    hal::serialPrint_P(PSTR("lcd i2c B/s: "));
+    hal::serialPrint((long)fbI2cBytesPerSec());
+    hal::serialPrint_P(PSTR(" queue max: "));
+    hal::serialPrint((long)hal::lcdQueueDepthMax());
+    hal::serialPrint_P(PSTR(" stalls: "));
+    hal::serialPrint((long)hal::lcdQueueStalls());
+    hal::serialPrint_P(PSTR(" nacks: "));
+    hal::serialPrint((long)hal::lcdNackCount());
+    hal::serialPrintln_P(PSTR(""));
+#endif
+#ifdef USE_LORA
+    hal::serialPrint_P(PSTR("rx frames: "));
+    hal::serialPrint((long)rxQueueReceived());
+    hal::serialPrint_P(PSTR(" dropped: "));
+    hal::serialPrint((long)rxQueueDropped());
+    hal::serialPrintln_P(PSTR(""));
+#ifdef STATS
+    hal::serialPrint_P(PSTR("tx queued: "));
+    hal::serialPrint((long)txQueued());
+    hal::serialPrint_P(PSTR(" sent: "));
+    hal::serialPrint((long)txSent());
+    hal::serialPrint_P(PSTR(" coalesced: "));
+    hal::serialPrint((long)txCoalesced());
+    hal::serialPrint_P(PSTR(" dropped: "));
+    hal::serialPrint((long)txDropped());
+    hal::serialPrintln_P(PSTR(""));
+#ifdef LISTEN_BEFORE_TALK
+    hal::serialPrint_P(PSTR("lbt cad: "));
+    hal::serialPrint((long)txLbtChecks());
+    hal::serialPrint_P(PSTR(" busy: "));
+    hal::serialPrint((long)txLbtBusy());
+    hal::serialPrint_P(PSTR(" forced: "));
+    hal::serialPrint((long)txLbtForced());
+    hal::serialPrint_P(PSTR(" backoff ms: "));
+    hal::serialPrint((long)txLbtBackoffMs());
+    hal::serialPrintln_P(PSTR(""));
+#endif
+#endif
+#ifdef TDMA_BEACONS
+    hal::serialPrint_P(PSTR("slot: "));
+    hal::serialPrint((long)slotsOwn());
+    hal::serialPrint_P(PSTR(" root: "));
+    hal::serialPrint((long)slotsRoot());
+    hal::serialPrint_P(PSTR(" age: "));
+    hal::serialPrint((long)slotsAge());
+    hal::serialPrint_P(PSTR(" resyncs: "));
+    hal::serialPrint((long)slotsResyncs());
+    hal::serialPrint_P(PSTR(" moves: "));
+    hal::serialPrint((long)slotsMoves());
+    hal::serialPrint_P(PSTR(" missed: "));
+    hal::serialPrint((long)slotsMissed());
+    hal::serialPrint_P(PSTR(" last fix ms: "));
+    hal::serialPrint((long)slotsLastCorrectionMs());
+    hal::serialPrintln_P(PSTR(""));
+#endif
+#ifdef STATS
+    unsigned long now = hal::millis();
+    hal::serialPrint_P(PSTR("airtime last hour ms: "));
+    hal::serialPrint((long)txAirtimeLastHourMs(now));
+    hal::serialPrint_P(PSTR(" duty permille: "));
+    hal::serialPrint((long)txDutyCyclePermille(now));
+    hal::serialPrintln_P(PSTR(""));
+#endif
+    byte heard = 0;
+    for (byte i = 0; i < NODE_TABLE_SLOTS; ++i)
+    {
+        if (nodeAt(i) != NULL)
+            ++heard;
+    }
+    hal::serialPrint_P(PSTR("nodes: "));
+    hal::serialPrint((long)heard);
+#ifdef STATE_BEACONS
+    // Supply voltage of each, from its state beacons
+    for (byte i = 0; i < NODE_TABLE_SLOTS; ++i)
+    {
+        const NodeEntry *node = nodeAt(i);
+        if (node == NULL || node->battery == 0)
+            continue;
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)node->id);
+        hal::serialPrint_P(PSTR(":"));
+        hal::serialPrint((long)node->battery * FRAME_BATTERY_MV);
+        hal::serialPrint_P(PSTR("mV"));
+    }
+#endif
+    hal::serialPrintln_P(PSTR(""));
+#ifdef STATS
+    hal::serialPrint_P(PSTR("relay forwarded: "));
+    hal::serialPrint((long)relayForwarded());
+    hal::serialPrint_P(PSTR(" duplicates: "));
+    hal::serialPrint((long)relayDuplicates());
+    hal::serialPrint_P(PSTR(" of "));
+    hal::serialPrint((long)relayLookups());
+    hal::serialPrint_P(PSTR(" ("));
+    hal::serialPrint(relayLookups() ? (long)relayDuplicates() * 100 / relayLookups() : 0L);
+    hal::serialPrintln_P(PSTR("%)"));
+#endif
+#ifdef AUTH_FRAMES
+    hal::serialPrint_P(authHasKey() ? PSTR("auth key set") : PSTR("auth key MISSING"));
+    hal::serialPrint_P(PSTR(" bad tags: "));
+    hal::serialPrint((long)authBadTags());
+    hal::serialPrint_P(PSTR(" replays: "));
+    hal::serialPrint((long)authReplays());
+    hal::serialPrintln_P(PSTR(""));
+#endif
+    if (ownPanic)
+    {
+        hal::serialPrint_P(PSTR("panic frames: "));
+        hal::serialPrint((long)panicFramesSent);
+        hal::serialPrint_P(panicAcked ? PSTR(" delivered in ms: ") : PSTR(" not delivered"));
+        if (panicAcked)
+            hal::serialPrint((long)panicAckLatency);
+        hal::serialPrintln_P(PSTR(""));
+    }
+#endif
+#ifdef BATTERY_MODE
+    hal::serialPrint_P(PSTR("cad sniffs: "));
+    hal::serialPrint((long)batterySniffs);
+    hal::serialPrint_P(PSTR(" woke: "));
+    hal::serialPrint((long)batteryWakeups);
+    hal::serialPrintln_P(PSTR(""));
+#endif
+    hal::serialPrint_P(PSTR("log level: "));
+    hal::serialPrint((long)logLevel());
+#ifdef STATS
+    hal::serialPrint_P(PSTR(" sent: "));
+    hal::serialPrint((long)logWritten());
+    hal::serialPrint_P(PSTR(" dropped: "));
+    hal::serialPrint((long)logDropped());
+#endif
+#ifdef TELEMETRY
+    hal::serialPrint_P(PSTR(" telemetry dropped: "));
+    hal::serialPrint((long)telDropped());
+#endif
+    hal::serialPrintln_P(PSTR(""));
+    hal::serialPrint_P(PSTR("journal dropped: "));
+    hal::serialPrint((long)journalDropped());
+    hal::serialPrintln_P(PSTR(""));
+    // Free RAM the stack has never reached since boot
+    hal::serialPrint_P(PSTR("stack never used B: "));
+    hal::serialPrint((long)hal::stackUnused());
+    hal::serialPrintln_P(PSTR(""));
+#ifdef STATS
+    // Worst lateness per task, in TASK_* order
+    hal::serialPrint_P(PSTR("task late ms:"));
+    for (byte t = 0; t < TASK_COUNT; ++t)
+    {
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)schedMaxLateMs(t));
+    }
+    hal::serialPrintln_P(PSTR(""));
+#endif
+}
 
-        // Clear remote digits if timed out (no heartbeat/press updates)
-        for (int idx = 0; idx <= 3; ++idx)
+// Helper: single-character commands typed into the serial monitor
+//   s  print statistics
+//   j  print the event journal
+//   l  step the log level down (ERROR wraps back round to LOG_LEVEL)
+//   p  print the loop profile (USE_PROFILER), P clears it
+void handleSerialCommand()
+{
+    int c = hal::serialRead();
+#ifdef AUTH_FRAMES
+    if (authKeyInput(c))
+        return;
+#endif
+    if (c == 's')
+        printStats();
+    else if (c == 'j')
+        journalDump();
+    else if (c == 'l')
+    {
+        logSetLevel(logLevel() == LOG_ERROR ? LOG_LEVEL : logLevel() - 1);
+        hal::serialPrint_P(PSTR("log level: "));
+        hal::serialPrint((long)logLevel());
+        hal::serialPrintln_P(PSTR(""));
+    }
+#ifdef AUTH_FRAMES
+    else if (c == 'a')
+    {
+        // What a tag adds to each panic and ACK, sent or received
+        uint32_t us = authBenchMicros();
+        hal::serialPrint_P(PSTR("auth tag us: "));
+        hal::serialPrint((long)(us / AUTH_BENCH_TAGS));
+#ifdef ARDUINO
+        hal::serialPrint_P(PSTR(" cycles: "));
+        hal::serialPrint((long)(us * (F_CPU / 1000000UL) / AUTH_BENCH_TAGS));
+#endif
+        hal::serialPrintln_P(PSTR(""));
+    }
+#endif
+#ifdef USE_PROFILER
+    else if (c == 'p')
+        profReport();
+    else if (c == 'P')
+        profReset();
+#endif
+}
+
+// Task: bring up the radio, then the LCD, one step per run; see BOOT_*
+void taskBoot(uint32_t now)
+{
+#ifdef USE_LORA
+    if (bootStep == BOOT_RADIO_RESET)
+    {
+        hal::radioReset(false);
+        bootStep = BOOT_RADIO;
+        schedIn(TASK_BOOT, now, RADIO_RESET_WAIT_MS);
+        return;
+    }
+    if (bootStep == BOOT_RADIO)
+    {
+        // Radio profile in config.h
+        loRaOk = hal::radioBegin(LORA_FREQ);
+        bootRadioMs = (uint16_t)hal::millis();
+        if (loRaOk)
+        {
+            hal::radioReceive();
+#ifndef BATTERY_MODE
+            // Beacons would cost a long preamble at full power every few seconds
+#ifdef TDMA_BEACONS
+            slotsBegin(nodeId, now);
+            schedAt(TASK_BEACON, slotsNextBeaconAt(now));
+#else
+            schedAt(TASK_BEACON, now);
+#endif
+#endif
+        }
+        else
         {
-            if (lastReceivedAt[idx] != 0 && (millis() - lastReceivedAt[idx]) > RECEIVE_TIMEOUT_MS)
+            fbClear();
+            fbPrint_P(0, 0, PSTR("LoRa: FAILED"));
+            if (LOG_ON(LOG_ERROR))
             {
-                lcd.setCursor(idx, 1);
-                lcd.print('-');
-                lastReceivedAt[idx] = 0;
-                // If this was button 4, also clear the name row
-                if (idx == 3)
-                {
-                    lcd.setCursor(0, 0);
-                    for (int p = 0; p < 16; ++p)
-                        lcd.print(' ');
-                }
+                logText_P(PSTR("LoRa init failed"));
+                logEnd();
             }
         }
+        bootStep = BOOT_LCD;
+        schedAt(TASK_BOOT, now);
+        return;
     }
 #endif
-    
-    // Show signal strength on main idle screen (when not in naming or panic mode)
-    if (!namingMode && !panicMode)
+    uint8_t waitMs = hal::lcdBegin();
+    if (waitMs > 0)
     {
-        static unsigned long lastMainDisplay = 0;
-        unsigned long now = millis();
-        if (lastMainDisplay == 0 || (now - lastMainDisplay) >= 100)
+        schedIn(TASK_BOOT, now, waitMs);
+        return;
+    }
+    bootLcdMs = (uint16_t)hal::millis();
+    bootStep = BOOT_DONE;
+    schedAt(TASK_LCD_FLUSH, now);
+    if (LOG_ON(LOG_INFO))
+    {
+        logText_P(PSTR("boot ms: buttons "));
+        logNumber(bootButtonsMs);
+#ifdef USE_LORA
+        logText_P(PSTR(" radio "));
+        logNumber(bootRadioMs);
+#endif
+        logText_P(PSTR(" lcd "));
+        logNumber(bootLcdMs);
+        logEnd();
+    }
+}
+
+// The timed jobs, in TASK_* order, with their periods (0 for one-shot).
+// Tasks of a role that does not need them are left out, with their code.
+static const SchedTask taskTable[] PROGMEM = {
+    {taskButtons, BUTTON_SAMPLE_MS},
+    {taskDisplay, DISPLAY_INTERVAL_MS},
+    {taskLcdFlush, LCD_FRAME_MS},
+    {taskRssiTimeout, 0},
+#ifdef USE_LORA
+    {ROLE.sendsAlerts ? taskPanicResend : NULL, 0},
+#ifdef TDMA_BEACONS
+    {taskBeacon, 0},
+#else
+    {taskBeacon, BEACON_INTERVAL_MS},
+#endif
+    {ROLE.sendsAlerts ? taskHoldResend : NULL, HOLD_RESEND_MS},
+    {ROLE.receivesAlerts ? taskRxTimeout : NULL, 0},
+    {ROLE.receivesAlerts ? taskSendAck : NULL, 0},
+#else
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+    {NULL, 0},
+#endif
+    {taskBoot, 0},
+    {taskMessage, 0},
+#ifdef TELEMETRY
+    {telStats, TELEMETRY_PERIOD_MS},
+#endif
+};
+static_assert(sizeof(taskTable) / sizeof(taskTable[0]) == TASK_COUNT, "one taskTable entry per task");
+
+void setup()
+{
+    // Mark the free RAM first so printStats() can report the stack high-water mark
+    hal::stackPaint();
+#ifdef USE_LORA
+    // The radio reset has to be held a little; released by TASK_BOOT
+    hal::radioReset(true);
+#endif
+
+    // No waiting for the serial monitor: opening it resets the Nano anyway
+#ifdef TELEMETRY
+    hal::serialBegin(TELEMETRY_BAUD);
+#else
+    hal::serialBegin(BAUD_RATE);
+#endif
+
+    // Register the timed jobs; each is armed when it has something to do
+    schedBegin(taskTable);
+
+    // Load device name from EEPROM (fixed length NAME_MAX_LEN)
+    for (int i = 0; i < NAME_MAX_LEN; ++i)
+    {
+        uint8_t c = hal::eepromRead(NAME_EEPROM_ADDR + i);
+        if (c == 0xFF || c == 0)
+            c = 'a';
+        deviceName[i] = (char)c;
+    }
+    deviceName[NAME_MAX_LEN] = '\0';
+    loadNodeId();
+#ifdef AUTH_FRAMES
+    authBegin();
+    if (!authHasKey() && LOG_ON(LOG_WARN))
+    {
+        logText_P(PSTR("no auth key: K + 32 hex"));
+        logEnd();
+    }
+#endif
+    nodeTableBegin();
+    journalBegin(nodeId, hal::millis());
+    // Random start so a rebooted unit does not repeat a panic sequence number
+    // that receivers still have on screen
+    panicSeq = (byte)hal::entropy();
+
+    // Buttons
+    hal::pinInputPullup(PINS.button[0]);
+    hal::pinInputPullup(PINS.button[1]);
+    hal::pinInputPullup(PINS.button[2]);
+    hal::pinInputPullup(PINS.button[3]);
+    hal::pinInputPullup(PINS.button[4]);
+    buttonsBegin();
+
+    // Buzzer
+    hal::pinOutput(PINS.buzzer);
+    buzzerBegin();
+
+    // Screens are drawn into the shadow; TASK_BOOT starts flushing it
+    fbBegin();
+#ifndef USE_LORA
+    fbPrint_P(0, 0, PSTR("LoRa: disabled "));
+#endif
+
+    unsigned long now = hal::millis();
+    schedAt(TASK_BUTTONS, now);
+    schedAt(TASK_DISPLAY, now);
+#ifdef TELEMETRY
+    telEvent(JOURNAL_BOOT, nodeId, 0, 0, now);
+    schedIn(TASK_TELEMETRY, now, TELEMETRY_PERIOD_MS);
+#endif
+#ifdef USE_LORA
+    schedIn(TASK_BOOT, now, RADIO_RESET_HOLD_MS);
+#else
+    schedAt(TASK_BOOT, now);
+#endif
+    bootButtonsMs = (uint16_t)now;
+}
+
+void loop()
+{
+#ifdef TELEMETRY
+    telLoopPass();
+#endif
+    // Drain frames queued by the DIO0 receive interrupt (no SPI polling here)
+#ifdef USE_LORA
+    if (loRaOk)
+    {
+        PROF_BEGIN(t);
+        RxPacket pkt;
+        while (rxQueuePop(pkt))
         {
-            // Display RSSI % on top right
-            lcd.setCursor(LCD_COLS - 3, 0);
-            if (rssiPercent < 10)
-                lcd.print("  ");
-            else if (rssiPercent < 100)
-                lcd.print(" ");
-            char buf[4];
-            sprintf(buf, "%d", rssiPercent);
-            lcd.print(buf);
-            lcd.print("%");
-            
-            // Display time since last signal on bottom right (tenths of a second)
-            unsigned long timeSinceLastSignal = (now - lastRssiUpdate) / 100;
-            lcd.setCursor(LCD_COLS - 3, 1);
-            if (timeSinceLastSignal < 10)
-                lcd.print("  ");
-            else if (timeSinceLastSignal < 100)
-                lcd.print(" ");
-            sprintf(buf, "%ld", timeSinceLastSignal);
-            lcd.print(buf);
-            lcd.print("t");
-            
-            lastMainDisplay = now;
+            // Update RSSI display
+            updateRssiDisplay(pkt.rssi);
+
+            Frame f;
+            bool decoded = frameDecode(pkt.data, pkt.len, f, LEGACY_FRAMES);
+#ifdef TELEMETRY
+            telFrame(decoded ? f.type : TEL_FRAME_UNDECODED, decoded ? f.node : TEL_FRAME_UNDECODED,
+                     pkt.rssi < -128 ? -128 : pkt.rssi, pkt.snr, pkt.len, hal::millis());
+#endif
+            if (decoded)
+                handleFrame(f, pkt.len, pkt.rssi);
         }
+        PROF_END(PROF_RX, t);
     }
-    
-    // Reset RSSI to 0 if no packets received for RSSI_TIMEOUT
-    unsigned long now = millis();
-    if (rssiPercent > 0 && (now - lastRssiUpdate) > RSSI_TIMEOUT)
+#endif
+
+    // Timed jobs (buttons, resends, timeouts, redraws) run only when due
+    schedRun(hal::millis());
+
+#ifdef USE_LORA
+    // Next queued frame goes on air once TxDone has fired for the last one
+    if (loRaOk)
+    {
+        PROF_BEGIN(t);
+        txQueueService(hal::millis());
+        PROF_END(PROF_TX, t);
+    }
+#endif
+
+    // Journal records and remote names trickle into EEPROM one byte per pass
+    journalService();
+    nodeTableService();
+#ifdef AUTH_FRAMES
+    authService();
+#endif
+
+    handleSerialCommand();
+
+#ifdef BATTERY_MODE
+    if (loRaOk && bootStep == BOOT_DONE)
     {
-        rssiPercent = 0;
+        batteryService(hal::millis());
+        return;
     }
+#endif
+
+    // Nothing due: sleep until the next interrupt. The Timer0 tick wakes us
+    // within ~1 ms; buttons, DIO0 and the UART wake us immediately.
+    if (schedIdle(hal::millis()))
+        hal::idle();
 }
@@ -0,0 +1,177 @@
+// Entry point for the `native` env: runs setup()/loop() against the simulated
+// board with a virtual clock, so timing paths (debounce, hold resend, panic
+// resend, receive timeouts) can be exercised and loop throughput measured
+// without hardware.
+//
+//   program [--loops N] [--tick-us U] [--press B@MS[+HOLD]]
+//           [--serial TEXT@MS] [--inject TEXT@MS] [--loopback] [--quiet]
+//
+//   --loops N        loop() iterations to run (default 100000)
+//   --tick-us U      virtual time that passes per loop() iteration (default 100)
+//   --press B@MS     press button B (1..5) at virtual time MS, hold for HOLD ms
+//                    (default 100); may be repeated
+//   --serial T@MS    type T into the serial console at MS; may be repeated
+//   --inject T@MS    deliver packet T over the air at MS: ASCII text, or hex
+//                    bytes when prefixed with 0x (e.g. 0xa301); may be repeated
+//   --loopback       echo transmitted packets back into the receiver
+//   --quiet          do not echo the sketch's serial output
+
+#if !defined(ARDUINO) && !defined(PANIC_SIM_NODE)
+
+#include "hal.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+namespace
+{
+struct ScriptEvent
+{
+    uint32_t atMs;
+    int button;      // 1..5, 0 for an injected packet, -1 for serial input
+    bool pressed;
+    std::string packet;
+};
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--loops N] [--tick-us U] [--press B@MS[+HOLD]]\n"
+            "          [--serial TEXT@MS] [--inject TEXT@MS] [--loopback] [--quiet]\n",
+            prog);
+    exit(2);
+}
+
+// "0x..." is a hex dump, anything else is sent as ASCII
+std::string decodePacketArg(const std::string &arg)
+{
+    if (arg.compare(0, 2, "0x") != 0)
+        return arg;
+    std::string bytes;
+    for (size_t i = 2; i + 1 < arg.size(); i += 2)
+        bytes.push_back((char)strtoul(arg.substr(i, 2).c_str(), NULL, 16));
+    return bytes;
+}
+
+// Parses "X@MS" and returns the part before '@'
+std::string splitAt(const char *arg, uint32_t *atMs, const char *prog)
+{
+    const char *at = strrchr(arg, '@');
+    if (at == NULL)
+        usage(prog);
+    *atMs = (uint32_t)strtoul(at + 1, NULL, 10);
+    return std::string(arg, at - arg);
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long loops = 100000;
+    unsigned long tickUs = 100;
+    bool loopback = false;
+    std::vector<ScriptEvent> script;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--loops") == 0 && hasValue)
+            loops = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--tick-us") == 0 && hasValue)
+            tickUs = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--press") == 0 && hasValue)
+        {
+            uint32_t atMs;
+            uint32_t holdMs = 100;
+            std::string spec = argv[++i];
+            const char *plus = strchr(spec.c_str(), '+');
+            if (plus != NULL)
+            {
+                holdMs = (uint32_t)strtoul(plus + 1, NULL, 10);
+                spec.erase(plus - spec.c_str());
+            }
+            int button = atoi(splitAt(spec.c_str(), &atMs, argv[0]).c_str());
+            if (button < 1 || button > 5)
+                usage(argv[0]);
+            script.push_back(ScriptEvent{atMs, button, true, std::string()});
+            script.push_back(ScriptEvent{atMs + holdMs, button, false, std::string()});
+        }
+        else if (strcmp(arg, "--serial") == 0 && hasValue)
+        {
+            uint32_t atMs;
+            std::string text = splitAt(argv[++i], &atMs, argv[0]);
+            script.push_back(ScriptEvent{atMs, -1, false, text});
+        }
+        else if (strcmp(arg, "--inject") == 0 && hasValue)
+        {
+            uint32_t atMs;
+            std::string packet = decodePacketArg(splitAt(argv[++i], &atMs, argv[0]));
+            script.push_back(ScriptEvent{atMs, 0, false, packet});
+        }
+        else if (strcmp(arg, "--loopback") == 0)
+            loopback = true;
+        else if (strcmp(arg, "--quiet") == 0)
+            sim::setSerialEcho(false);
+        else
+            usage(argv[0]);
+    }
+
+    sim::reset();
+    sim::setRadioLoopback(loopback, -60);
+
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+    setup();
+    uint32_t bootMs = hal::millis();
+
+    std::chrono::steady_clock::time_point loopStart = std::chrono::steady_clock::now();
+    for (unsigned long n = 0; n < loops; ++n)
+    {
+        uint32_t now = hal::millis();
+        for (size_t e = 0; e < script.size(); ++e)
+        {
+            ScriptEvent &ev = script[e];
+            if (ev.atMs == UINT32_MAX || now < bootMs + ev.atMs)
+                continue;
+            if (ev.button < 0)
+                sim::serialInput(ev.packet.c_str());
+            else if (ev.button != 0)
+                sim::setButton(PINS.button[ev.button - 1], ev.pressed);
+            else
+                sim::radioInject((const uint8_t *)ev.packet.data(), (uint8_t)ev.packet.size(), -70);
+            ev.atMs = UINT32_MAX; // consumed
+        }
+        loop();
+        sim::advanceUs(tickUs);
+    }
+    std::chrono::steady_clock::time_point wallEnd = std::chrono::steady_clock::now();
+
+    double loopSec = std::chrono::duration<double>(wallEnd - loopStart).count();
+    double totalSec = std::chrono::duration<double>(wallEnd - wallStart).count();
+    char row[LCD_COLS + 1];
+    printf("\n--- native run ---\n");
+    for (uint8_t r = 0; r < LCD_ROWS; ++r)
+    {
+        sim::lcdRow(r, row);
+        printf("lcd[%u]   |%s|\n", r, row);
+    }
+    printf("virtual  %lu ms (setup %lu ms)\n", (unsigned long)hal::millis(), (unsigned long)bootMs);
+    printf("packets  %lu sent, %lu ms airtime, %lu refused while on air\n", (unsigned long)sim::radioSentCount(),
+           (unsigned long)(sim::radioAirtimeUs() / 1000), (unsigned long)sim::radioRefusedCount());
+    printf("lcd ops  %lu (%lu I2C bytes)\n", (unsigned long)sim::lcdOps(),
+           (unsigned long)(sim::lcdOps() * LCD_I2C_BYTES_PER_OP));
+    printf("idle     %lu of %lu passes (%lu in power-down)\n", (unsigned long)sim::idleCount(), loops,
+           (unsigned long)sim::powerDownCount());
+    printf("loops    %lu in %.3f s wall (%.0f loops/s, %.3f s total)\n",
+           loops, loopSec, loopSec > 0 ? loops / loopSec : 0.0, totalSec);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "node_table.h"
+#include "frame.h"
+#include "hal.h"
+
+#include <string.h>
+
+// State bit marking a used slot
+#define NODE_IN_USE 0x80
+
+static NodeEntry nodes[NODE_TABLE_SLOTS];
+
+// Name waiting to be written to the EEPROM slot of table slot pendingSlot,
+// a byte per nodeTableService() call
+#define NO_PENDING 0xFF
+static char pendingName[NAME_MAX_LEN];
+static uint8_t pendingSlot = NO_PENDING;
+static uint8_t pendingByte = 0;
+
+static uint16_t nameAddr(uint8_t slot)
+{
+    return NODE_NAMES_EEPROM_ADDR + (uint16_t)slot * NAME_MAX_LEN;
+}
+
+void nodeTableBegin()
+{
+    memset(nodes, 0, sizeof(nodes));
+    pendingSlot = NO_PENDING;
+}
+
+NodeEntry *nodeFind(uint8_t id)
+{
+    for (uint8_t i = 0; i < NODE_TABLE_SLOTS; ++i)
+    {
+        if ((nodes[i].state & NODE_IN_USE) && nodes[i].id == id)
+            return &nodes[i];
+    }
+    return NULL;
+}
+
+NodeEntry &nodeTouch(uint8_t id, uint32_t now)
+{
+    NodeEntry *node = nodeFind(id);
+    if (node == NULL)
+    {
+        // Free slot, else the longest silent node not in panic, else the
+        // longest silent one
+        uint8_t victim = 0;
+        for (uint8_t i = 0; i < NODE_TABLE_SLOTS; ++i)
+        {
+            const NodeEntry &n = nodes[i];
+            const NodeEntry &v = nodes[victim];
+            if (!(n.state & NODE_IN_USE))
+            {
+                victim = i;
+                break;
+            }
+            bool nPanic = (n.state & NODE_PANIC) != 0;
+            bool vPanic = (v.state & NODE_PANIC) != 0;
+            if (nPanic != vPanic ? vPanic : now - n.lastSeen > now - v.lastSeen)
+                victim = i;
+        }
+        node = &nodes[victim];
+        if (pendingSlot == victim)
+            pendingSlot = NO_PENDING; // the evicted node's name is of no use now
+        node->id = id;
+        node->state = NODE_IN_USE;
+        node->rssi = 0;
+        node->panicSeq = 0;
+        node->nameHash = 0;
+#ifdef STATE_BEACONS
+        node->battery = 0;
+#endif
+#ifdef AUTH_FRAMES
+        node->authCounter = 0;
+#endif
+    }
+    node->lastSeen = now;
+    return *node;
+}
+
+NodeEntry *nodeAt(uint8_t slot)
+{
+    return (nodes[slot].state & NODE_IN_USE) ? &nodes[slot] : NULL;
+}
+
+uint8_t nodeSlot(const NodeEntry &node)
+{
+    return (uint8_t)(&node - nodes);
+}
+
+void nodeSetName(NodeEntry &node, const char *name, uint8_t len)
+{
+    if (len > NAME_MAX_LEN)
+        len = NAME_MAX_LEN;
+    uint16_t hash = frameNameHash(name, len);
+    if (hash == node.nameHash)
+        return; // same name again, spare the EEPROM
+    uint8_t slot = nodeSlot(node);
+    if (pendingSlot != NO_PENDING && pendingSlot != slot)
+        return; // another name is still going out; the node announces it again
+    memset(pendingName, 0, sizeof(pendingName));
+    memcpy(pendingName, name, len);
+    pendingSlot = slot;
+    pendingByte = 0;
+    node.nameHash = hash;
+}
+
+void nodeForgetName(NodeEntry &node)
+{
+    if (pendingSlot == nodeSlot(node))
+        pendingSlot = NO_PENDING;
+    node.nameHash = 0;
+}
+
+void nodeTableService()
+{
+    if (pendingSlot == NO_PENDING || !hal::eepromReady())
+        return;
+    hal::eepromUpdate(nameAddr(pendingSlot) + pendingByte, pendingName[pendingByte]);
+    if (++pendingByte == NAME_MAX_LEN)
+        pendingSlot = NO_PENDING;
+}
+
+bool nodeTablePending()
+{
+    return pendingSlot != NO_PENDING;
+}
+
+uint8_t nodeName(const NodeEntry &node, char *out)
+{
+    uint8_t len = 0;
+    if (node.nameHash != 0)
+    {
+        // Still on its way to the EEPROM: read it from RAM
+        uint8_t slot = nodeSlot(node);
+        bool pending = pendingSlot == slot;
+        uint16_t addr = nameAddr(slot);
+        while (len < NAME_MAX_LEN)
+        {
+            char c = pending ? pendingName[len] : hal::eepromRead(addr + len);
+            if (c == 0)
+                break;
+            out[len++] = c;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
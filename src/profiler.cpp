@@ -0,0 +1,107 @@
+#include "profiler.h"
+
+#include <string.h>
+
+#ifdef USE_PROFILER
+
+struct PhaseStats
+{
+    uint16_t buckets[PROF_BUCKETS];
+    uint32_t maxUs;
+};
+
+static PhaseStats stats[PROF_PHASES];
+
+// micros() at the panic button edge, valid while pressPending
+static uint32_t pressUs = 0;
+static bool pressPending = false;
+
+// Same order as ProfPhase
+static const char phaseNames[PROF_PHASES][8] PROGMEM = {
+    "rx", "buttons", "long", "panic", "idle", "flush", "tx", "press"};
+
+static uint8_t bucketOf(uint32_t us)
+{
+    uint8_t b = 0;
+    for (uint32_t v = us >> 4; v != 0 && b < PROF_BUCKETS - 1; v >>= 1)
+        ++b;
+    return b;
+}
+
+void profRecord(uint8_t phase, uint32_t us)
+{
+    PhaseStats &s = stats[phase];
+    uint16_t &count = s.buckets[bucketOf(us)];
+    if (count != 0xFFFF)
+        ++count;
+    if (us > s.maxUs)
+        s.maxUs = us;
+}
+
+void profPressAt(uint32_t us)
+{
+    // A second press before the frame went out does not restart the clock
+    if (pressPending)
+        return;
+    pressUs = us;
+    pressPending = true;
+}
+
+void profPanicSent()
+{
+    if (!pressPending)
+        return;
+    pressPending = false;
+    profRecord(PROF_PRESS_TO_TX, hal::micros() - pressUs);
+}
+
+void profReport()
+{
+    hal::serialPrintln_P(PSTR("phase n p99<us max us | log2 buckets from 16 us"));
+    for (uint8_t p = 0; p < PROF_PHASES; ++p)
+    {
+        const PhaseStats &s = stats[p];
+        uint32_t total = 0;
+        for (uint8_t b = 0; b < PROF_BUCKETS; ++b)
+            total += s.buckets[b];
+
+        // Upper bound of the bucket holding the 99th percentile; the open
+        // last bucket and anything above the max are bounded by the max
+        uint32_t p99 = 0;
+        uint32_t seen = 0;
+        for (uint8_t b = 0; b < PROF_BUCKETS && total != 0; ++b)
+        {
+            seen += s.buckets[b];
+            if (seen * 100 >= total * 99)
+            {
+                p99 = (uint32_t)16 << b;
+                if (b == PROF_BUCKETS - 1 || p99 > s.maxUs)
+                    p99 = s.maxUs + 1;
+                break;
+            }
+        }
+
+        hal::serialPrint_P(phaseNames[p]);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)total);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)p99);
+        hal::serialPrint_P(PSTR(" "));
+        hal::serialPrint((long)s.maxUs);
+        hal::serialPrint_P(PSTR(" |"));
+        for (uint8_t b = 0; b < PROF_BUCKETS; ++b)
+        {
+            hal::serialPrint_P(PSTR(" "));
+            hal::serialPrint((long)s.buckets[b]);
+        }
+        hal::serialPrintln_P(PSTR(""));
+    }
+}
+
+void profReset()
+{
+    memset(stats, 0, sizeof(stats));
+    pressPending = false;
+}
+
+#endif // USE_PROFILER
@@ -0,0 +1,143 @@
+#include "relay.h"
+#include "hal.h"
+#include "tx_queue.h"
+
+#ifdef USE_LORA
+
+// 4 bytes per entry (5 with AUTH_FRAMES); the timestamp is millis() in 256
+// ms ticks
+struct SeenKey
+{
+    uint8_t origin;
+    uint8_t type;
+    uint8_t seq;
+#ifdef AUTH_FRAMES
+    uint8_t counter; // panics: low byte of the auth counter, new with every retry
+#endif
+    uint8_t stamp;
+};
+
+#define STAMP_SHIFT 8
+#define TTL_TICKS (RELAY_CACHE_TTL_MS >> STAMP_SHIFT)
+static_assert(TTL_TICKS > 0 && TTL_TICKS < 128, "RELAY_CACHE_TTL_MS out of range");
+#ifndef AUTH_FRAMES
+// Retries of a panic are the same frame again: remember one for less than
+// the first retry interval, so the next retry is new
+#define PANIC_TTL_TICKS (RELAY_PANIC_TTL_MS >> STAMP_SHIFT)
+static_assert(PANIC_TTL_TICKS > 0 && RELAY_PANIC_TTL_MS < PANIC_RETRY_MS,
+              "RELAY_PANIC_TTL_MS must be below PANIC_RETRY_MS");
+#endif
+
+static SeenKey seen[RELAY_CACHE_SLOTS]; // origin 0 marks a free slot
+static uint8_t nextSlot = 0;
+// Entries are dropped as they expire, at every lookup; after a quiet spell
+// of a whole TTL all of them are, so the 8-bit stamps never wrap around
+static uint32_t lastLookupAt = 0;
+
+#ifdef STATS
+static uint16_t lookups = 0;
+static uint16_t duplicates = 0;
+static uint16_t forwarded = 0;
+#endif
+
+#ifdef AUTH_FRAMES
+// Tells a panic's retries apart; the other types keep their key per seq
+static uint8_t retryOf(const Frame &frame)
+{
+    return frame.type == FRAME_PANIC ? (uint8_t)frame.authCounter : 0;
+}
+#endif
+
+static uint8_t ttlTicks(uint8_t type)
+{
+#ifndef AUTH_FRAMES
+    if (type == FRAME_PANIC)
+        return PANIC_TTL_TICKS;
+#endif
+    return TTL_TICKS;
+}
+
+// Whether a copy of frame is cached; drops the entries that have expired
+static bool cached(const Frame &frame, uint8_t stamp, uint32_t now)
+{
+    bool quiet = now - lastLookupAt >= RELAY_CACHE_TTL_MS;
+    lastLookupAt = now;
+    for (uint8_t i = 0; i < RELAY_CACHE_SLOTS; ++i)
+    {
+        SeenKey &k = seen[i];
+        if (quiet || (uint8_t)(stamp - k.stamp) >= ttlTicks(k.type))
+        {
+            k.origin = 0;
+            continue;
+        }
+        if (k.origin == frame.node && k.type == frame.type && k.seq == frame.seq
+#ifdef AUTH_FRAMES
+            && k.counter == retryOf(frame)
+#endif
+        )
+            return true;
+    }
+    return false;
+}
+
+bool relaySeen(const Frame &frame, uint32_t now)
+{
+    return cached(frame, (uint8_t)(now >> STAMP_SHIFT), now);
+}
+
+bool relayFirstSeen(const Frame &frame, uint32_t now)
+{
+    uint8_t stamp = (uint8_t)(now >> STAMP_SHIFT);
+    STAT_INC(lookups);
+    if (cached(frame, stamp, now))
+    {
+        STAT_INC(duplicates);
+        return false;
+    }
+
+    SeenKey &k = seen[nextSlot];
+    k.origin = frame.node;
+    k.type = frame.type;
+    k.seq = frame.seq;
+#ifdef AUTH_FRAMES
+    k.counter = retryOf(frame);
+#endif
+    k.stamp = stamp;
+    nextSlot = (nextSlot + 1) % RELAY_CACHE_SLOTS;
+    return true;
+}
+
+bool relayForward(const Frame &frame)
+{
+    if (frame.hops >= RELAY_HOP_LIMIT)
+        return false;
+
+    Frame copy = frame;
+    ++copy.hops;
+    uint8_t buf[RADIO_FRAME_MAX];
+    uint8_t len = frameEncode(copy, buf);
+    uint16_t backoff = (hal::entropy() % RELAY_BACKOFF_SLOTS) * RELAY_SLOT_MS;
+    if (!txQueuePush(buf, len, txPriorityFor(frame.type), backoff))
+        return false;
+    STAT_INC(forwarded);
+    return true;
+}
+
+#ifdef STATS
+uint16_t relayLookups()
+{
+    return lookups;
+}
+
+uint16_t relayDuplicates()
+{
+    return duplicates;
+}
+
+uint16_t relayForwarded()
+{
+    return forwarded;
+}
+#endif
+
+#endif // USE_LORA
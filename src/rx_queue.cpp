@@ -0,0 +1,64 @@
+#include "rx_queue.h"
+
+#include <string.h>
+
+// Keep slot accesses on their side of the index updates
+#define COMPILER_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+static RxPacket slots[RX_QUEUE_SLOTS];
+static volatile uint8_t head = 0; // written by the producer
+static volatile uint8_t tail = 0; // written by the consumer
+static volatile uint16_t received = 0;
+static volatile uint16_t dropped = 0;
+
+RxPacket *rxQueueReserve()
+{
+    if ((uint8_t)(head - tail) >= RX_QUEUE_SLOTS)
+    {
+        ++dropped;
+        return NULL;
+    }
+    return &slots[head & (RX_QUEUE_SLOTS - 1)];
+}
+
+void rxQueueCommit()
+{
+    COMPILER_BARRIER();
+    ++head;
+    ++received;
+}
+
+bool rxQueuePop(RxPacket &out)
+{
+    if (head == tail)
+        return false;
+    const RxPacket &slot = slots[tail & (RX_QUEUE_SLOTS - 1)];
+    out.len = slot.len;
+    out.snr = slot.snr;
+    out.rssi = slot.rssi;
+    memcpy(out.data, slot.data, slot.len);
+    COMPILER_BARRIER();
+    ++tail;
+    return true;
+}
+
+// 16-bit counters are updated from the interrupt; re-read until stable
+// instead of masking interrupts
+static uint16_t readCounter(volatile uint16_t &counter)
+{
+    uint16_t value;
+    do
+        value = counter;
+    while (value != counter);
+    return value;
+}
+
+uint16_t rxQueueReceived()
+{
+    return readCounter(received);
+}
+
+uint16_t rxQueueDropped()
+{
+    return readCounter(dropped);
+}
@@ -0,0 +1,143 @@
+#include "scheduler.h"
+#include "hal.h"
+
+#include <string.h>
+
+static_assert(SCHED_MAX_TASKS <= 16, "armed and ran are 16-bit masks");
+
+struct Task
+{
+    uint32_t due;
+#ifdef STATS
+    uint16_t maxLate;
+#endif
+};
+
+static const SchedTask *table = NULL; // PROGMEM
+static Task tasks[SCHED_MAX_TASKS];
+static uint16_t armed = 0; // bit per task
+// Earliest due time of the armed tasks; may be stale-early after a stop,
+// which only costs one extra scan
+static uint32_t nextDue = 0;
+static bool haveNext = false;
+
+// Wrap-safe: due lies at or before now
+static bool reached(uint32_t now, uint32_t due)
+{
+    return (int32_t)(now - due) >= 0;
+}
+
+static bool isArmed(uint8_t id)
+{
+    return armed & (1U << id);
+}
+
+static void updateNextDue()
+{
+    haveNext = false;
+    for (uint8_t i = 0; i < SCHED_MAX_TASKS; ++i)
+    {
+        if (isArmed(i) && (!haveNext || (int32_t)(tasks[i].due - nextDue) < 0))
+        {
+            nextDue = tasks[i].due;
+            haveNext = true;
+        }
+    }
+}
+
+void schedBegin(const SchedTask *taskTable)
+{
+    table = taskTable;
+    memset(tasks, 0, sizeof(tasks));
+    armed = 0;
+    haveNext = false;
+}
+
+void schedAt(uint8_t id, uint32_t dueMs)
+{
+    tasks[id].due = dueMs;
+    armed |= 1U << id;
+    if (!haveNext || (int32_t)(dueMs - nextDue) < 0)
+    {
+        nextDue = dueMs;
+        haveNext = true;
+    }
+}
+
+void schedIn(uint8_t id, uint32_t now, uint32_t delayMs)
+{
+    schedAt(id, now + delayMs);
+}
+
+void schedStop(uint8_t id)
+{
+    armed &= ~(1U << id);
+}
+
+bool schedArmed(uint8_t id)
+{
+    return isArmed(id);
+}
+
+void schedRun(uint32_t now)
+{
+    if (!haveNext || !reached(now, nextDue))
+        return;
+
+    // Earliest deadline first; each task runs at most once per call so a
+    // task re-arming itself for now cannot starve loop()
+    uint16_t ran = 0;
+    for (;;)
+    {
+        uint8_t pick = SCHED_MAX_TASKS;
+        for (uint8_t i = 0; i < SCHED_MAX_TASKS; ++i)
+        {
+            if (!isArmed(i) || (ran & (1U << i)) || !reached(now, tasks[i].due))
+                continue;
+            if (pick == SCHED_MAX_TASKS || (int32_t)(tasks[i].due - tasks[pick].due) < 0)
+                pick = i;
+        }
+        if (pick == SCHED_MAX_TASKS)
+            break;
+
+        Task &t = tasks[pick];
+        uint32_t late = now - t.due;
+#ifdef STATS
+        if (late > t.maxLate)
+            t.maxLate = late > 0xFFFF ? 0xFFFF : (uint16_t)late;
+#endif
+
+        // Re-arm before the call so the task can stop or reschedule itself
+        uint16_t period = pgm_read_word(&table[pick].periodMs);
+        if (period == 0)
+            armed &= ~(1U << pick);
+        else if (late >= period)
+            t.due = now + period;
+        else
+            t.due += period;
+
+        ran |= 1U << pick;
+        TaskFn fn = (TaskFn)pgm_read_ptr(&table[pick].fn);
+        fn(now);
+    }
+    updateNextDue();
+}
+
+bool schedIdle(uint32_t now)
+{
+    return !haveNext || !reached(now, nextDue);
+}
+
+uint32_t schedDueIn(uint32_t now)
+{
+    if (!haveNext)
+        return 0xFFFFFFFF;
+    return reached(now, nextDue) ? 0 : nextDue - now;
+}
+
+#ifdef STATS
+uint16_t schedMaxLateMs(uint8_t id)
+{
+    return tasks[id].maxLate;
+}
+#endif
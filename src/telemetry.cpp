@@ -0,0 +1,114 @@
+#include "telemetry.h"
+
+#ifdef TELEMETRY
+
+#include "hal.h"
+#include "rx_queue.h"
+#include "tx_queue.h"
+
+#define TEL_PAYLOAD_MAX 15
+
+static uint8_t record[3 + TEL_PAYLOAD_MAX + 1];
+static uint8_t recordLen = 0;
+static uint16_t passes = 0;
+static uint16_t dropped = 0;
+
+static void begin(uint8_t type)
+{
+    record[0] = TEL_SYNC;
+    record[1] = type;
+    recordLen = 3;
+}
+
+static void put8(uint8_t v)
+{
+    record[recordLen++] = v;
+}
+
+static void put16(uint16_t v)
+{
+    put8((uint8_t)v);
+    put8((uint8_t)(v >> 8));
+}
+
+static void put32(uint32_t v)
+{
+    put16((uint16_t)v);
+    put16((uint16_t)(v >> 16));
+}
+
+// Length and CRC-8 in, then out if the TX buffer takes all of it
+static void send()
+{
+    record[2] = recordLen - 3;
+    uint8_t crc = 0;
+    for (uint8_t i = 1; i < recordLen; ++i)
+    {
+        crc ^= record[i];
+        for (uint8_t b = 0; b < 8; ++b)
+            crc = (crc & 0x80) ? (uint8_t)(crc << 1) ^ 0x07 : (uint8_t)(crc << 1);
+    }
+    record[recordLen++] = crc;
+    if (hal::serialTxFree() < recordLen)
+    {
+        if (dropped != 0xFFFF)
+            ++dropped;
+        return;
+    }
+    hal::serialWrite(record, recordLen);
+}
+
+void telEvent(uint8_t event, uint8_t node, int8_t rssi, uint8_t arg, uint32_t now)
+{
+    begin(TEL_EVENT);
+    put32(now);
+    put8(event);
+    put8(node);
+    put8((uint8_t)rssi);
+    put8(arg);
+    send();
+}
+
+void telFrame(uint8_t type, uint8_t node, int8_t rssi, int8_t snr, uint8_t len, uint32_t now)
+{
+    begin(TEL_FRAME);
+    put32(now);
+    put8(type);
+    put8(node);
+    put8((uint8_t)rssi);
+    put8((uint8_t)snr);
+    put8(len);
+    send();
+}
+
+void telLoopPass()
+{
+    if (passes != 0xFFFF)
+        ++passes;
+}
+
+void telStats(uint32_t now)
+{
+    begin(TEL_STATS);
+    put32(now);
+    put16(passes);
+#ifdef USE_LORA
+    put8(txQueueDepth());
+    put16(rxQueueDropped());
+#else
+    put8(0);
+    put16(0);
+#endif
+    put16(dropped);
+    put16(hal::lcdQueueStalls());
+    put16(hal::stackUnused());
+    send();
+    passes = 0;
+}
+
+uint16_t telDropped()
+{
+    return dropped;
+}
+
+#endif // TELEMETRY
@@ -0,0 +1,411 @@
+#include "tx_queue.h"
+#include "airtime.h"
+#include "beacon_slots.h"
+#include "hal.h"
+#include "profiler.h"
+
+#include <string.h>
+
+#ifdef USE_LORA
+
+#define HOUR_MS 3600000UL
+
+struct TxSlot
+{
+    uint8_t prio;
+    uint8_t len;
+    uint32_t readyAt;
+};
+
+// Waiting frames in arrival order; their bytes lie back to back in pool in
+// the same order, so a short frame only takes the room it needs
+static TxSlot slots[TX_QUEUE_SLOTS];
+static uint8_t pool[TX_QUEUE_BYTES];
+static uint8_t depth = 0;
+static uint8_t used = 0; // bytes of pool
+
+#ifdef STATS
+static uint16_t queued = 0;
+static uint16_t sent = 0;
+static uint16_t coalesced = 0;
+static uint16_t dropped = 0;
+
+static uint32_t hourStart = 0;
+static uint32_t thisHourMs = 0;
+static uint32_t prevHourMs = 0;
+#endif
+
+// Last transmit handed to the radio
+static uint32_t lastTxAt = 0;
+static uint32_t lastTxAirtimeMs = 0;
+
+#ifdef LISTEN_BEFORE_TALK
+// A CAD takes two symbols (66 ms at SF12). No result after this long means
+// it was cut short, e.g. by battery mode putting the radio into receive.
+#define LBT_CAD_TIMEOUT_MS 500
+
+static bool lbtSensing = false;
+static uint32_t lbtStartedAt = 0;
+static uint32_t lbtBackoffUntil = 0;
+static uint8_t lbtTries = 0; // busy CADs in a row
+
+#ifdef STATS
+static uint16_t lbtChecks = 0;
+static uint16_t lbtBusy = 0;
+static uint16_t lbtForced = 0;
+static uint32_t lbtBackoffMs = 0;
+#endif
+#endif
+
+static uint8_t *dataOf(uint8_t i)
+{
+    uint8_t *data = pool;
+    for (uint8_t j = 0; j < i; ++j)
+        data += slots[j].len;
+    return data;
+}
+
+// Give frame i newLen bytes, moving the frames after it
+static void resizeSlot(uint8_t i, uint8_t newLen)
+{
+    uint8_t *data = dataOf(i);
+    uint8_t after = used - (uint8_t)(data - pool) - slots[i].len;
+    memmove(data + newLen, data + slots[i].len, after);
+    used = used - slots[i].len + newLen;
+    slots[i].len = newLen;
+}
+
+static void removeSlot(uint8_t i)
+{
+    resizeSlot(i, 0);
+    --depth;
+    memmove(&slots[i], &slots[i + 1], (depth - i) * sizeof(TxSlot));
+}
+
+// Evict frames below prio (never frame keep, whose index is kept up to
+// date), the newest of the lowest priority first, until bytes more fit in
+// the pool and, with slot, a slot is free. Evicts nothing and returns false
+// if that is not possible.
+static bool makeRoom(uint8_t bytes, bool slot, uint8_t prio, uint8_t &keep)
+{
+    uint8_t freeBytes = TX_QUEUE_BYTES - used;
+    uint8_t freeSlots = TX_QUEUE_SLOTS - depth;
+    for (uint8_t i = 0; i < depth; ++i)
+    {
+        if (i != keep && slots[i].prio < prio)
+        {
+            freeBytes += slots[i].len;
+            ++freeSlots;
+        }
+    }
+    if (freeBytes < bytes || (slot && freeSlots == 0))
+        return false;
+
+    while (used + bytes > TX_QUEUE_BYTES || (slot && depth == TX_QUEUE_SLOTS))
+    {
+        uint8_t victim = depth;
+        for (uint8_t i = 0; i < depth; ++i)
+        {
+            if (i != keep && slots[i].prio < prio && (victim == depth || slots[i].prio <= slots[victim].prio))
+                victim = i;
+        }
+        removeSlot(victim);
+        STAT_INC(dropped);
+        if (victim < keep)
+            --keep;
+    }
+    return true;
+}
+
+// How a new frame relates to a waiting one with the same header (type/button
+// and node): it repeats it, supersedes it or has to go out as well
+enum TxMerge
+{
+    TX_MERGE_SAME,
+    TX_MERGE_REPLACE,
+    TX_MERGE_NONE
+};
+
+static uint8_t mergeWith(uint8_t i, const uint8_t *data, uint8_t len)
+{
+    // Press, release, press: the last one must not jump the release, whatever
+    // sequence numbers they carry (RELAY_MODE numbers every one)
+    if ((data[0] & 0x90) == 0x80)
+    {
+        const uint8_t *later = dataOf(i);
+        for (uint8_t j = i; j < depth; later += slots[j++].len)
+        {
+            if (j > i && slots[j].len >= 2 && later[0] == (data[0] ^ 0x08) && later[1] == data[1])
+                return TX_MERGE_NONE;
+        }
+    }
+    uint16_t waiting = frameSeqKey(dataOf(i), slots[i].len);
+    uint16_t incoming = frameSeqKey(data, len);
+    if ((waiting ^ incoming) & 0xFF00)
+        return TX_MERGE_NONE; // every acknowledged node gets its own
+    if (waiting != incoming)
+        return TX_MERGE_REPLACE; // a newer panic, or the ACK of one
+    return TX_MERGE_SAME;
+}
+
+#ifdef STATS
+static void rollHour(uint32_t now)
+{
+    while (now - hourStart >= HOUR_MS)
+    {
+        prevHourMs = thisHourMs;
+        thisHourMs = 0;
+        hourStart += HOUR_MS;
+    }
+}
+#endif
+
+#ifdef LISTEN_BEFORE_TALK
+// Listen before talk for a frame that is ready: true once a CAD found the
+// channel free, or after LBT_MAX_TRIES busy ones. Otherwise a CAD or a
+// back-off is under way and the frame has to wait.
+static bool lbtClear(uint32_t now)
+{
+    if (!lbtSensing)
+    {
+        if ((int32_t)(now - lbtBackoffUntil) < 0)
+            return false;
+        hal::radioSniff();
+        lbtSensing = true;
+        lbtStartedAt = now;
+        STAT_INC(lbtChecks);
+        return false;
+    }
+
+    int8_t heard = hal::radioSniffResult();
+    if (heard < 0)
+    {
+        if (now - lbtStartedAt >= LBT_CAD_TIMEOUT_MS)
+            lbtSensing = false; // sense again
+        return false;
+    }
+    lbtSensing = false;
+    if (heard == 0)
+    {
+        lbtTries = 0;
+        return true;
+    }
+
+    // Busy: most likely a frame for us, so receive it meanwhile
+    STAT_INC(lbtBusy);
+    hal::radioReceive();
+    if (++lbtTries >= LBT_MAX_TRIES)
+    {
+        STAT_INC(lbtForced);
+        lbtTries = 0;
+        return true;
+    }
+    uint8_t window = LBT_BACKOFF_SLOTS << (lbtTries < 4 ? lbtTries - 1 : 3);
+    uint32_t delayMs = (1 + hal::entropy() % window) * (uint32_t)LBT_SLOT_MS;
+    lbtBackoffUntil = now + delayMs;
+    STAT_ADD(lbtBackoffMs, delayMs);
+    return false;
+}
+#endif
+
+uint8_t txPriorityFor(uint8_t frameType)
+{
+    if (frameType == FRAME_PANIC || frameType == FRAME_ACK)
+        return TX_PRIO_PANIC;
+    if (frameType == FRAME_BEACON)
+        return TX_PRIO_BEACON;
+    return TX_PRIO_PRESS;
+}
+
+bool txQueuePush(const uint8_t *data, uint8_t len, uint8_t prio, uint16_t delayMs)
+{
+    // Same type/button and node already waiting: it says the same thing, or
+    // the newer frame takes its place in the queue
+    const uint8_t *waiting = pool;
+    for (uint8_t i = 0; i < depth; waiting += slots[i++].len)
+    {
+        if (slots[i].len >= 2 && len >= 2 && waiting[0] == data[0] && waiting[1] == data[1])
+        {
+            uint8_t merge = mergeWith(i, data, len);
+            if (merge == TX_MERGE_NONE)
+                continue;
+#ifdef STATE_BEACONS
+            // A copy with a state snapshot replaces one without
+            if (frameHasState(data, len) && !frameHasState(waiting, slots[i].len))
+                merge = TX_MERGE_REPLACE;
+#endif
+            if (merge == TX_MERGE_REPLACE)
+            {
+                if (len > slots[i].len && !makeRoom(len - slots[i].len, false, prio, i))
+                {
+                    STAT_INC(dropped);
+                    return false;
+                }
+                resizeSlot(i, len);
+                memcpy(dataOf(i), data, len);
+            }
+            if (prio > slots[i].prio)
+                slots[i].prio = prio;
+            STAT_INC(coalesced);
+            return true;
+        }
+    }
+
+    // Full: evict the newest of the lowest-priority frames, if below ours
+    uint8_t none = depth;
+    if (!makeRoom(len, true, prio, none))
+    {
+        STAT_INC(dropped);
+        return false;
+    }
+
+    TxSlot &slot = slots[depth];
+    slot.prio = prio;
+    slot.len = len;
+    slot.readyAt = hal::millis() + delayMs;
+    memcpy(pool + used, data, len);
+    used += len;
+    ++depth;
+    STAT_INC(queued);
+    return true;
+}
+
+#ifdef STATE_BEACONS
+bool txQueueRestate(const Frame &state, uint8_t prio)
+{
+    uint8_t *data = pool;
+    for (uint8_t i = 0; i < depth; data += slots[i++].len)
+    {
+        TxSlot &slot = slots[i];
+        if (slot.len >= 2 && data[1] == state.node && frameRestate(data, slot.len, state))
+        {
+            if (prio > slot.prio)
+                slot.prio = prio;
+            STAT_INC(coalesced);
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+void txQueueService(uint32_t now)
+{
+    if (depth == 0)
+        return;
+    // Still on air. Past twice the expected time-on-air assume the TxDone
+    // interrupt was missed; radioSend() refuses if the radio really is busy.
+    if (hal::radioBusy() && now - lastTxAt < 2 * lastTxAirtimeMs)
+        return;
+
+    uint8_t next = depth;
+    for (uint8_t i = 0; i < depth; ++i)
+    {
+        if ((int32_t)(now - slots[i].readyAt) < 0)
+            continue; // still backing off
+        if (next == depth || slots[i].prio > slots[next].prio)
+            next = i;
+    }
+    if (next == depth)
+        return;
+#ifdef LISTEN_BEFORE_TALK
+    if (!lbtClear(now))
+        return;
+#endif
+
+    TxSlot &slot = slots[next];
+    uint8_t *data = dataOf(next);
+#ifdef TDMA_BEACONS
+    // Our beacon carries the superframe position it goes on air at; one
+    // that would overrun its slot is dropped
+    if (!slotsStamp(data, slot.len, now))
+    {
+        STAT_INC(dropped);
+        removeSlot(next);
+        // The channel check left the radio in standby: back to listening
+        hal::radioReceive();
+        return;
+    }
+#endif
+    if (!hal::radioSend(data, slot.len))
+        return;
+#ifdef USE_PROFILER
+    Frame frame;
+    if (frameDecode(data, slot.len, frame, false) && frame.type == FRAME_PANIC && frame.hops == 0)
+        profPanicSent();
+#endif
+
+    lastTxAt = now;
+    lastTxAirtimeMs = loraTimeOnAirUs(slot.len, RADIO.spreadingFactor, RADIO.bandwidthHz,
+                                      RADIO.codingRate, LORA_PREAMBLE_LEN) / 1000;
+#ifdef STATS
+    rollHour(now);
+    thisHourMs += lastTxAirtimeMs;
+    ++sent;
+#endif
+    removeSlot(next);
+}
+
+uint8_t txQueueDepth()
+{
+    return depth;
+}
+
+#ifdef STATS
+uint16_t txQueued()
+{
+    return queued;
+}
+
+uint16_t txSent()
+{
+    return sent;
+}
+
+uint16_t txCoalesced()
+{
+    return coalesced;
+}
+
+uint16_t txDropped()
+{
+    return dropped;
+}
+
+#ifdef LISTEN_BEFORE_TALK
+uint16_t txLbtChecks()
+{
+    return lbtChecks;
+}
+
+uint16_t txLbtBusy()
+{
+    return lbtBusy;
+}
+
+uint16_t txLbtForced()
+{
+    return lbtForced;
+}
+
+uint32_t txLbtBackoffMs()
+{
+    return lbtBackoffMs;
+}
+#endif
+
+uint32_t txAirtimeLastHourMs(uint32_t now)
+{
+    rollHour(now);
+    // The part of the previous hour still inside the sliding window
+    uint32_t remainingMs = HOUR_MS - (now - hourStart);
+    return thisHourMs + (uint32_t)((uint64_t)prevHourMs * remainingMs / HOUR_MS);
+}
+
+uint16_t txDutyCyclePermille(uint32_t now)
+{
+    return (uint16_t)(txAirtimeLastHourMs(now) / (HOUR_MS / 1000));
+}
+#endif
+
+#endif // USE_LORA
@@ -0,0 +1,343 @@
+// Unit tests for the frame codec (lib/frame): `pio test -e native`
+
+#include <unity.h>
+#include <string.h>
+#include "frame.h"
+
+static Frame makeFrame(uint8_t type, uint8_t node)
+{
+    Frame f;
+    memset(&f, 0, sizeof(f));
+    f.type = type;
+    f.node = node;
+    return f;
+}
+
+static Frame roundTrip(const Frame &in, uint8_t expectedLen)
+{
+    uint8_t buf[FRAME_MAX_LEN + FRAME_AUTH_TLV_LEN];
+    uint8_t len = frameEncode(in, buf);
+    TEST_ASSERT_EQUAL_UINT8(expectedLen, len);
+    Frame out;
+    TEST_ASSERT_TRUE(frameDecode(buf, len, out, false));
+    TEST_ASSERT_EQUAL_UINT8(in.type, out.type);
+    TEST_ASSERT_EQUAL_UINT8(in.node, out.node);
+    return out;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_press_and_release_are_two_bytes()
+{
+    Frame f = makeFrame(FRAME_PRESS, 42);
+    f.button = 3;
+    uint8_t buf[FRAME_MAX_LEN];
+    TEST_ASSERT_EQUAL_UINT8(2, frameEncode(f, buf));
+    TEST_ASSERT_EQUAL_HEX8(0xA3, buf[0]); // 0x80 | version 1 << 5 | press 3
+    TEST_ASSERT_EQUAL_UINT8(42, buf[1]);
+    TEST_ASSERT_EQUAL_UINT8(3, roundTrip(f, 2).button);
+
+    f.type = FRAME_RELEASE;
+    TEST_ASSERT_EQUAL_UINT8(3, roundTrip(f, 2).button);
+}
+
+void test_panic_carries_seq()
+{
+    Frame f = makeFrame(FRAME_PANIC, 7);
+    f.seq = 200;
+    Frame out = roundTrip(f, 5);
+    TEST_ASSERT_EQUAL_UINT8(200, out.seq);
+    TEST_ASSERT_EQUAL_UINT8(0, out.hops);
+    TEST_ASSERT_EQUAL_UINT8(0, out.nameLen);
+}
+
+void test_ack_carries_target_and_seq()
+{
+    Frame f = makeFrame(FRAME_ACK, 9);
+    f.target = 7;
+    f.seq = 200;
+    Frame out = roundTrip(f, 6);
+    TEST_ASSERT_EQUAL_UINT8(7, out.target);
+    TEST_ASSERT_EQUAL_UINT8(200, out.seq);
+}
+
+void test_seq_key_without_decoding()
+{
+    uint8_t buf[FRAME_MAX_LEN];
+    Frame f = makeFrame(FRAME_ACK, 9);
+    f.target = 7;
+    f.seq = 200;
+    f.hops = 1;
+    TEST_ASSERT_EQUAL_UINT16(7 << 8 | 200, frameSeqKey(buf, frameEncode(f, buf)));
+    f = makeFrame(FRAME_PANIC, 9);
+    f.seq = 5;
+    f.nameLen = 3;
+    memcpy(f.name, "BOB", 3);
+    TEST_ASSERT_EQUAL_UINT16(5, frameSeqKey(buf, frameEncode(f, buf)));
+    f = makeFrame(FRAME_PRESS, 9);
+    TEST_ASSERT_EQUAL_UINT16(0, frameSeqKey(buf, frameEncode(f, buf)));
+    const uint8_t legacy[] = {'X', '|', 'B'};
+    TEST_ASSERT_EQUAL_UINT16(0, frameSeqKey(legacy, sizeof(legacy)));
+}
+
+void test_hops_and_name()
+{
+    Frame f = makeFrame(FRAME_BEACON, 3);
+    f.hops = 2;
+    f.nameLen = 5;
+    memcpy(f.name, "ALICE", 5);
+    Frame out = roundTrip(f, 2 + 3 + 2 + 5);
+    TEST_ASSERT_EQUAL_UINT8(2, out.hops);
+    TEST_ASSERT_EQUAL_UINT8(5, out.nameLen);
+    TEST_ASSERT_EQUAL_MEMORY("ALICE", out.name, 5);
+}
+
+void test_beacon_carries_time()
+{
+    Frame f = makeFrame(FRAME_BEACON, 3);
+    f.timeRoot = 2;
+    f.timeAge = 5;
+    f.timeMs = 19203; // kept in 8 ms steps
+    uint8_t buf[FRAME_MAX_LEN];
+    TEST_ASSERT_EQUAL_UINT8(7, frameEncode(f, buf));
+    TEST_ASSERT_EQUAL_HEX8(FRAME_TLV_TIME, buf[2]);
+    TEST_ASSERT_EQUAL_HEX8(0xA9, buf[5]); // age 5 << 5 | 2400 >> 8
+    TEST_ASSERT_EQUAL_HEX8(0x60, buf[6]);
+    Frame out = roundTrip(f, 7);
+    TEST_ASSERT_EQUAL_UINT8(2, out.timeRoot);
+    TEST_ASSERT_EQUAL_UINT8(5, out.timeAge);
+    TEST_ASSERT_EQUAL_UINT16(19200, out.timeMs);
+
+    // Out of range values are clamped, root 0 means no clock
+    f.timeAge = 9;
+    f.timeMs = 65535;
+    out = roundTrip(f, 7);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_TIME_MAX_AGE, out.timeAge);
+    TEST_ASSERT_EQUAL_UINT16(FRAME_TIME_MAX_MS, out.timeMs);
+    const uint8_t noRoot[] = {0xB1, 3, FRAME_TLV_TIME, 3, 0, 0x21, 0x00};
+    TEST_ASSERT_TRUE(frameDecode(noRoot, sizeof(noRoot), out, false));
+    TEST_ASSERT_EQUAL_UINT8(0, out.timeRoot);
+    TEST_ASSERT_EQUAL_UINT16(0, out.timeMs);
+}
+
+void test_beacon_carries_state()
+{
+    Frame f = makeFrame(FRAME_BEACON, 3);
+    f.state = FRAME_STATE_VALID | FRAME_STATE_PANIC | 1 << 3;
+    f.battery = 4100 / FRAME_BATTERY_MV;
+    f.nameCheck = frameNameCheck(frameNameHash("BOB", 3));
+    uint8_t buf[FRAME_MAX_LEN];
+    TEST_ASSERT_EQUAL_UINT8(7, frameEncode(f, buf));
+    TEST_ASSERT_EQUAL_HEX8(FRAME_TLV_STATE, buf[2]);
+    TEST_ASSERT_EQUAL_HEX8(0xA8, buf[4]);
+    Frame out = roundTrip(f, 7);
+    TEST_ASSERT_EQUAL_HEX8(f.state, out.state);
+    TEST_ASSERT_EQUAL_UINT8(205, out.battery);
+    TEST_ASSERT_EQUAL_UINT8(f.nameCheck, out.nameCheck);
+
+    // Nothing held, no panic, no name: still present
+    f.state = FRAME_STATE_VALID;
+    f.nameCheck = frameNameCheck(0);
+    TEST_ASSERT_EQUAL_UINT8(0, f.nameCheck);
+    out = roundTrip(f, 7);
+    TEST_ASSERT_EQUAL_HEX8(FRAME_STATE_VALID, out.state);
+
+    // A waiting frame is brought up to date in place; one without the TLV is left alone
+    uint8_t len = frameEncode(f, buf);
+    TEST_ASSERT_TRUE(frameHasState(buf, len));
+    Frame now = makeFrame(FRAME_BEACON, 3);
+    now.state = FRAME_STATE_VALID | 1 << 3;
+    now.battery = 180;
+    now.nameCheck = 0x5A;
+    TEST_ASSERT_TRUE(frameRestate(buf, len, now));
+    TEST_ASSERT_TRUE(frameDecode(buf, len, out, false));
+    TEST_ASSERT_EQUAL_HEX8(now.state, out.state);
+    TEST_ASSERT_EQUAL_UINT8(180, out.battery);
+    TEST_ASSERT_EQUAL_HEX8(0x5A, out.nameCheck);
+    Frame press = makeFrame(FRAME_PRESS, 3);
+    len = frameEncode(press, buf);
+    TEST_ASSERT_FALSE(frameHasState(buf, len));
+    TEST_ASSERT_FALSE(frameRestate(buf, len, now));
+
+    // Everything at once still fits FRAME_MAX_LEN
+    f.type = FRAME_ACK;
+    f.target = 4;
+    f.seq = 9;
+    f.hops = 2;
+    f.timeRoot = 1;
+    f.nameLen = FRAME_NAME_MAX;
+    memset(f.name, 'N', FRAME_NAME_MAX);
+    roundTrip(f, FRAME_MAX_LEN);
+}
+
+void test_name_is_clipped_to_frame_name_max()
+{
+    Frame f = makeFrame(FRAME_BEACON, 3);
+    f.nameLen = FRAME_NAME_MAX + 5;
+    memset(f.name, 'N', FRAME_NAME_MAX);
+    Frame out = roundTrip(f, 2 + 2 + FRAME_NAME_MAX);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_NAME_MAX, out.nameLen);
+}
+
+void test_name_len_trims_trailing_spaces()
+{
+    TEST_ASSERT_EQUAL_UINT8(3, frameNameLen("BOB         ", FRAME_NAME_MAX));
+    TEST_ASSERT_EQUAL_UINT8(0, frameNameLen("            ", FRAME_NAME_MAX));
+    TEST_ASSERT_EQUAL_UINT8(4, frameNameLen("AB C", FRAME_NAME_MAX));
+    TEST_ASSERT_EQUAL_UINT8(2, frameNameLen("ABCDEF", 2));
+}
+
+void test_unknown_tlv_is_skipped()
+{
+    const uint8_t buf[] = {0xB0, 5, 0x7E, 2, 0xAA, 0xBB, FRAME_TLV_SEQ, 1, 9};
+    Frame out;
+    TEST_ASSERT_TRUE(frameDecode(buf, sizeof(buf), out, false));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PANIC, out.type);
+    TEST_ASSERT_EQUAL_UINT8(9, out.seq);
+}
+
+void test_malformed_frames_are_rejected()
+{
+    Frame out;
+    const uint8_t empty[] = {0};
+    TEST_ASSERT_FALSE(frameDecode(empty, 0, out, true));
+    const uint8_t noNode[] = {0xB0};
+    TEST_ASSERT_FALSE(frameDecode(noNode, sizeof(noNode), out, false));
+    const uint8_t version2[] = {0xC0 | 0x10, 5};
+    TEST_ASSERT_FALSE(frameDecode(version2, sizeof(version2), out, false));
+    const uint8_t unknownCode[] = {0xA0 | 0x1F, 5};
+    TEST_ASSERT_FALSE(frameDecode(unknownCode, sizeof(unknownCode), out, false));
+    const uint8_t truncatedTlv[] = {0xB0, 5, FRAME_TLV_NAME, 4, 'A', 'B'};
+    TEST_ASSERT_FALSE(frameDecode(truncatedTlv, sizeof(truncatedTlv), out, false));
+    const uint8_t danglingByte[] = {0xB0, 5, FRAME_TLV_SEQ, 1, 9, 0x01};
+    TEST_ASSERT_FALSE(frameDecode(danglingByte, sizeof(danglingByte), out, false));
+    const uint8_t ackWithoutTarget[] = {0xB3, 5};
+    TEST_ASSERT_FALSE(frameDecode(ackWithoutTarget, sizeof(ackWithoutTarget), out, false));
+}
+
+void test_auth_tlv_on_panic_and_ack_only()
+{
+    Frame f = makeFrame(FRAME_PANIC, 7);
+    f.seq = 200;
+    f.authCounter = 0x00010002;
+    f.authTag = 0xDEADBEEF;
+    uint8_t buf[FRAME_MAX_LEN + FRAME_AUTH_TLV_LEN];
+    TEST_ASSERT_EQUAL_UINT8(5 + FRAME_AUTH_TLV_LEN, frameEncode(f, buf));
+    TEST_ASSERT_EQUAL_HEX8(FRAME_TLV_AUTH, buf[5]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, buf[10]);
+    TEST_ASSERT_EQUAL_HEX8(0xDE, buf[11]);
+    Frame out = roundTrip(f, 5 + FRAME_AUTH_TLV_LEN);
+    TEST_ASSERT_EQUAL_UINT32(0x00010002, out.authCounter);
+    TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, out.authTag);
+
+    // A relayed copy keeps it
+    f.hops = 1;
+    out = roundTrip(f, 5 + 3 + FRAME_AUTH_TLV_LEN);
+    TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, out.authTag);
+
+    // Other frames neither send nor take it
+    f.type = FRAME_BEACON;
+    f.seq = 0;
+    f.hops = 0;
+    TEST_ASSERT_EQUAL_UINT8(2, frameEncode(f, buf));
+    const uint8_t beacon[] = {0xB1, 3, FRAME_TLV_AUTH, 8, 0, 0, 0, 1, 1, 2, 3, 4};
+    TEST_ASSERT_TRUE(frameDecode(beacon, sizeof(beacon), out, false));
+    TEST_ASSERT_EQUAL_UINT32(0, out.authCounter);
+}
+
+void test_speck_test_vector()
+{
+    // Speck64/128 from the designers' paper: key 1b1a1918 13121110 0b0a0908
+    // 03020100, plaintext 3b726574 7475432d, ciphertext 8c6fa548 454e028b
+    const uint8_t key[FRAME_AUTH_KEY_LEN] = {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0a, 0x0b,
+                                             0x10, 0x11, 0x12, 0x13, 0x18, 0x19, 0x1a, 0x1b};
+    uint32_t x = 0x3b726574;
+    uint32_t y = 0x7475432d;
+    frameSpeckEncrypt(key, x, y);
+    TEST_ASSERT_EQUAL_HEX32(0x8c6fa548, x);
+    TEST_ASSERT_EQUAL_HEX32(0x454e028b, y);
+}
+
+void test_auth_tag()
+{
+    uint8_t key[FRAME_AUTH_KEY_LEN];
+    for (uint8_t i = 0; i < FRAME_AUTH_KEY_LEN; ++i)
+        key[i] = i;
+    Frame f = makeFrame(FRAME_PANIC, 7);
+    f.seq = 200;
+    f.authCounter = 0x00010001;
+    // Known answers, so units built from different trees agree
+    TEST_ASSERT_EQUAL_HEX32(0xE09BF866, frameAuthTag(f, key));
+    Frame ack = makeFrame(FRAME_ACK, 3);
+    ack.target = 9;
+    ack.seq = 200;
+    ack.authCounter = 0x00010001;
+    TEST_ASSERT_EQUAL_HEX32(0x7EC44483, frameAuthTag(ack, key));
+
+    // Hops and name are not covered; everything else is
+    uint32_t tag = frameAuthTag(f, key);
+    f.hops = 2;
+    f.nameLen = 3;
+    memcpy(f.name, "BOB", 3);
+    TEST_ASSERT_EQUAL_HEX32(tag, frameAuthTag(f, key));
+    ++f.authCounter;
+    TEST_ASSERT_NOT_EQUAL(tag, frameAuthTag(f, key));
+    --f.authCounter;
+    f.node = 8;
+    TEST_ASSERT_NOT_EQUAL(tag, frameAuthTag(f, key));
+    f.node = 7;
+    key[15] ^= 1;
+    TEST_ASSERT_NOT_EQUAL(tag, frameAuthTag(f, key));
+}
+
+void test_legacy_frames_only_when_accepted()
+{
+    const uint8_t panic[] = {'X', '|', 'B', 'O', 'B'};
+    Frame out;
+    TEST_ASSERT_FALSE(frameDecode(panic, sizeof(panic), out, false));
+    TEST_ASSERT_TRUE(frameDecode(panic, sizeof(panic), out, true));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PANIC, out.type);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_NODE_LEGACY, out.node);
+    TEST_ASSERT_EQUAL_UINT8(3, out.nameLen);
+    TEST_ASSERT_EQUAL_MEMORY("BOB", out.name, 3);
+
+    const uint8_t press[] = {'P', '4', '|', 'A', 'L'};
+    TEST_ASSERT_TRUE(frameDecode(press, sizeof(press), out, true));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PRESS, out.type);
+    TEST_ASSERT_EQUAL_UINT8(3, out.button);
+    TEST_ASSERT_EQUAL_UINT8(2, out.nameLen);
+
+    const uint8_t beacon[] = {'T', 'X'};
+    TEST_ASSERT_TRUE(frameDecode(beacon, sizeof(beacon), out, true));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_BEACON, out.type);
+
+    const uint8_t garbage[] = {'Q', 'Z'};
+    TEST_ASSERT_FALSE(frameDecode(garbage, sizeof(garbage), out, true));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_press_and_release_are_two_bytes);
+    RUN_TEST(test_panic_carries_seq);
+    RUN_TEST(test_ack_carries_target_and_seq);
+    RUN_TEST(test_seq_key_without_decoding);
+    RUN_TEST(test_hops_and_name);
+    RUN_TEST(test_beacon_carries_time);
+    RUN_TEST(test_beacon_carries_state);
+    RUN_TEST(test_name_is_clipped_to_frame_name_max);
+    RUN_TEST(test_name_len_trims_trailing_spaces);
+    RUN_TEST(test_unknown_tlv_is_skipped);
+    RUN_TEST(test_malformed_frames_are_rejected);
+    RUN_TEST(test_auth_tlv_on_panic_and_ack_only);
+    RUN_TEST(test_speck_test_vector);
+    RUN_TEST(test_auth_tag);
+    RUN_TEST(test_legacy_frames_only_when_accepted);
+    return UNITY_END();
+}
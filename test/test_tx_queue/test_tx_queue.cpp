@@ -0,0 +1,181 @@
+// Unit tests for the transmit queue (src/tx_queue.cpp) against a stub radio
+// that is always free and a clear channel: `pio test -e native`
+
+#include <unity.h>
+#include <string.h>
+#include "frame.h"
+#include "hal.h"
+#include "tx_queue.h"
+
+// The queue and its airtime accounting, built into the test since the tests
+// do not build src/
+#include "../../src/airtime.cpp"
+#include "../../src/tx_queue.cpp"
+
+static uint32_t nowMs = 0;
+static uint8_t sentFrames[8][RADIO_FRAME_MAX];
+static uint8_t sentLen[8];
+static uint8_t sentCount = 0;
+
+namespace hal
+{
+uint32_t millis() { return nowMs; }
+uint16_t entropy() { return 0; }
+bool radioBusy() { return false; }
+void radioReceive() {}
+void radioSniff() {}
+int8_t radioSniffResult() { return 0; }
+bool radioSend(const uint8_t *data, uint8_t len)
+{
+    memcpy(sentFrames[sentCount], data, len);
+    sentLen[sentCount++] = len;
+    return true;
+}
+}
+
+static Frame makeFrame(uint8_t type, uint8_t button, uint8_t seq)
+{
+    Frame f;
+    memset(&f, 0, sizeof(f));
+    f.type = type;
+    f.node = 7;
+    f.button = button;
+    f.seq = seq;
+    return f;
+}
+
+static void push(const Frame &f)
+{
+    uint8_t buf[RADIO_FRAME_MAX];
+    TEST_ASSERT_TRUE(txQueuePush(buf, frameEncode(f, buf), txPriorityFor(f.type)));
+}
+
+// Send everything waiting; with listen-before-talk each frame takes one pass
+// to start the CAD and one to send
+static void drain()
+{
+    for (uint8_t pass = 0; pass < 32 && txQueueDepth() > 0; ++pass)
+    {
+        nowMs += 10;
+        txQueueService(nowMs);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, txQueueDepth());
+}
+
+static Frame sentFrame(uint8_t i)
+{
+    Frame f;
+    TEST_ASSERT_TRUE(frameDecode(sentFrames[i], sentLen[i], f, false));
+    return f;
+}
+
+void setUp()
+{
+    sentCount = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_repeat_is_coalesced()
+{
+    push(makeFrame(FRAME_PRESS, 3, 0));
+    push(makeFrame(FRAME_PRESS, 3, 0));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(1, sentCount);
+}
+
+void test_press_does_not_jump_its_release()
+{
+    // RELAY_MODE numbers every press and release
+    push(makeFrame(FRAME_PRESS, 3, 1));
+    push(makeFrame(FRAME_RELEASE, 3, 2));
+    push(makeFrame(FRAME_PRESS, 3, 3));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(3, sentCount);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PRESS, sentFrame(0).type);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_RELEASE, sentFrame(1).type);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PRESS, sentFrame(2).type);
+    TEST_ASSERT_EQUAL_UINT8(3, sentFrame(2).seq);
+}
+
+void test_newer_panic_replaces_waiting_one()
+{
+    push(makeFrame(FRAME_PANIC, 0, 1));
+    push(makeFrame(FRAME_PANIC, 0, 2));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(1, sentCount);
+    TEST_ASSERT_EQUAL_UINT8(2, sentFrame(0).seq);
+}
+
+void test_acks_to_different_nodes_both_go_out()
+{
+    Frame ack = makeFrame(FRAME_ACK, 0, 5);
+    ack.target = 20;
+    push(ack);
+    ack.target = 21;
+    push(ack);
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(2, sentCount);
+    TEST_ASSERT_EQUAL_UINT8(20, sentFrame(0).target);
+    TEST_ASSERT_EQUAL_UINT8(21, sentFrame(1).target);
+}
+
+static Frame named(Frame f)
+{
+    memcpy(f.name, "ABCDEFGHIJKL", FRAME_NAME_MAX);
+    f.nameLen = FRAME_NAME_MAX;
+    return f;
+}
+
+void test_long_frames_make_room_for_a_panic()
+{
+    // Named beacons fill the bytes; the panic evicts the newest ones
+    uint16_t dropped = txDropped();
+    uint8_t beacons = TX_QUEUE_BYTES / (2 + 2 + FRAME_NAME_MAX);
+    for (uint8_t node = 1; node <= beacons; ++node)
+    {
+        Frame beacon = named(makeFrame(FRAME_BEACON, 0, 0));
+        beacon.node = node;
+        push(beacon);
+    }
+    push(named(makeFrame(FRAME_PANIC, 0, 1)));
+    drain();
+    TEST_ASSERT_TRUE(txDropped() > dropped);
+    TEST_ASSERT_EQUAL_UINT16(beacons + 1, sentCount + (txDropped() - dropped));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_PANIC, sentFrame(0).type);
+    for (uint8_t i = 1; i < sentCount; ++i)
+        TEST_ASSERT_EQUAL_UINT8(i, sentFrame(i).node);
+}
+
+void test_longer_replacement_keeps_its_place()
+{
+    Frame first = makeFrame(FRAME_PANIC, 0, 1);
+    first.node = 1;
+    push(first);
+    Frame second = makeFrame(FRAME_PANIC, 0, 1);
+    second.node = 2;
+    push(second);
+    first.seq = 2;
+    push(named(first));
+    drain();
+    TEST_ASSERT_EQUAL_UINT8(2, sentCount);
+    TEST_ASSERT_EQUAL_UINT8(1, sentFrame(0).node);
+    TEST_ASSERT_EQUAL_UINT8(2, sentFrame(0).seq);
+    TEST_ASSERT_EQUAL_UINT8(FRAME_NAME_MAX, sentFrame(0).nameLen);
+    TEST_ASSERT_EQUAL_UINT8(2, sentFrame(1).node);
+    TEST_ASSERT_EQUAL_UINT8(1, sentFrame(1).seq);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_repeat_is_coalesced);
+    RUN_TEST(test_press_does_not_jump_its_release);
+    RUN_TEST(test_newer_panic_replaces_waiting_one);
+    RUN_TEST(test_acks_to_different_nodes_both_go_out);
+    RUN_TEST(test_long_frames_make_room_for_a_panic);
+    RUN_TEST(test_longer_replacement_keeps_its_place);
+    return UNITY_END();
+}
@@ -0,0 +1,225 @@
+#include "channel.h"
+#include "airtime.h"
+
+#include <math.h>
+#include <deque>
+#include <random>
+
+namespace
+{
+ChannelConfig cfg;
+size_t units = 0;
+std::vector<double> linkLoss; // dB, units x units, symmetric
+std::mt19937 rng;
+double noiseDbm = 0;
+double requiredSnrDb = 0;
+uint64_t lockUs = 0; // from the start of a frame until the receiver must be locked on it
+uint64_t preambleUs = 0;
+
+std::deque<Transmission> onAir;    // in start order
+std::deque<Transmission> finished; // kept while they overlap one still on air
+Transmission last;
+uint64_t busyUntilUs = 0;
+ChannelStats stats;
+
+double dbmToMw(double dbm)
+{
+    return pow(10.0, dbm / 10.0);
+}
+
+bool overlaps(const Transmission &a, const Transmission &b)
+{
+    return a.startUs < b.endUs && b.startUs < a.endUs;
+}
+
+RxOutcome decide(const Transmission &t, uint16_t unit, double rssi)
+{
+    double interferenceMw = 0;
+    const std::deque<Transmission> *lists[2] = {&finished, &onAir};
+    for (int l = 0; l < 2; ++l)
+    {
+        for (size_t i = 0; i < lists[l]->size(); ++i)
+        {
+            const Transmission &o = (*lists[l])[i];
+            if (!overlaps(t, o))
+                continue;
+            // A radio cannot receive while it transmits
+            if (o.sender == unit)
+                return RX_HALF_DUPLEX;
+            // Gone before the receiver had to lock on the preamble
+            if (o.endUs <= t.startUs + lockUs)
+                continue;
+            interferenceMw += dbmToMw(o.rssi[unit]);
+        }
+    }
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double errorRate = 1.0 / (1.0 + exp((rssi - noiseDbm - requiredSnrDb) / 1.0));
+    if (uniform(rng) < errorRate)
+        return RX_WEAK;
+    if (interferenceMw > 0 && rssi - 10.0 * log10(interferenceMw) < cfg.captureDb)
+        return RX_COLLISION;
+    return RX_OK;
+}
+}
+
+void channelBegin(const ChannelConfig &config, const std::vector<double> &x, const std::vector<double> &y,
+                  uint32_t seed)
+{
+    cfg = config;
+    units = x.size();
+    rng.seed(seed);
+    onAir.clear();
+    finished.clear();
+    busyUntilUs = 0;
+    stats = ChannelStats();
+
+    // Thermal noise over the bandwidth, and the SNR each SF demodulates at
+    // (SX1276 datasheet: -7.5 dB at SF7, 2.5 dB less per step)
+    noiseDbm = -174.0 + 10.0 * log10((double)cfg.bandwidthHz) + cfg.noiseFigureDb;
+    requiredSnrDb = -7.5 - 2.5 * (cfg.spreadingFactor - 7);
+    uint64_t symbolUs = ((uint64_t)1 << cfg.spreadingFactor) * 1000000 / cfg.bandwidthHz;
+    lockUs = cfg.preambleLen > 5 ? (cfg.preambleLen - 5) * symbolUs : 0;
+    preambleUs = cfg.preambleLen * symbolUs + symbolUs * 17 / 4;
+
+    std::normal_distribution<double> shadowing(0.0, cfg.shadowingDb);
+    linkLoss.assign(units * units, 0.0);
+    for (size_t a = 0; a < units; ++a)
+    {
+        for (size_t b = a + 1; b < units; ++b)
+        {
+            double d = hypot(x[a] - x[b], y[a] - y[b]);
+            if (d < cfg.d0M)
+                d = cfg.d0M;
+            double loss = cfg.pathLossD0Db + 10.0 * cfg.pathLossExponent * log10(d / cfg.d0M);
+            if (cfg.shadowingDb > 0)
+                loss += shadowing(rng);
+            linkLoss[a * units + b] = loss;
+            linkLoss[b * units + a] = loss;
+        }
+    }
+}
+
+uint64_t channelTransmit(uint16_t sender, uint64_t startUs, const uint8_t *data, uint8_t len)
+{
+    Transmission t;
+    t.sender = sender;
+    t.startUs = startUs;
+    t.endUs = startUs + channelTimeOnAirUs(len);
+    t.data.assign(data, data + len);
+    t.overlapped = false;
+
+    std::normal_distribution<double> fading(0.0, cfg.fadingDb);
+    t.rssi.resize(units);
+    for (size_t u = 0; u < units; ++u)
+    {
+        t.rssi[u] = cfg.txPowerDbm - linkLoss[sender * units + u];
+        if (cfg.fadingDb > 0)
+            t.rssi[u] += fading(rng);
+    }
+
+    for (size_t i = 0; i < onAir.size(); ++i)
+    {
+        if (onAir[i].endUs > startUs)
+        {
+            onAir[i].overlapped = true;
+            t.overlapped = true;
+        }
+    }
+
+    ++stats.transmissions;
+    stats.airtimeUs += t.endUs - t.startUs;
+    if (t.endUs > busyUntilUs)
+    {
+        stats.busyUs += t.endUs - (startUs > busyUntilUs ? startUs : busyUntilUs);
+        busyUntilUs = t.endUs;
+    }
+    onAir.push_back(t);
+    return t.endUs;
+}
+
+bool channelActive(uint16_t unit, uint64_t nowUs, bool wholeFrame)
+{
+    for (size_t i = 0; i < onAir.size(); ++i)
+    {
+        const Transmission &t = onAir[i];
+        uint64_t detectableUntil = wholeFrame ? t.endUs : t.startUs + preambleUs;
+        if (t.sender != unit && t.startUs <= nowUs && nowUs < detectableUntil &&
+            t.rssi[unit] >= channelSensitivityDbm())
+            return true;
+    }
+    return false;
+}
+
+uint64_t channelNextEndUs()
+{
+    uint64_t next = UINT64_MAX;
+    for (size_t i = 0; i < onAir.size(); ++i)
+    {
+        if (onAir[i].endUs < next)
+            next = onAir[i].endUs;
+    }
+    return next;
+}
+
+const Transmission &channelFinish(const std::vector<uint16_t> &receivers, std::vector<Reception> &out)
+{
+    size_t first = 0;
+    for (size_t i = 1; i < onAir.size(); ++i)
+    {
+        if (onAir[i].endUs < onAir[first].endUs)
+            first = i;
+    }
+    last = onAir[first];
+    onAir.erase(onAir.begin() + first);
+    if (last.overlapped)
+        ++stats.overlapped;
+
+    out.clear();
+    for (size_t r = 0; r < receivers.size(); ++r)
+    {
+        uint16_t unit = receivers[r];
+        if (unit == last.sender)
+            continue;
+        Reception rx;
+        rx.unit = unit;
+        rx.outcome = decide(last, unit, last.rssi[unit]);
+        rx.rssi = (int)lround(last.rssi[unit]);
+        double snr = last.rssi[unit] - noiseDbm;
+        rx.snrQuarterDb = (int8_t)(snr * 4 < -128 ? -128 : snr * 4 > 127 ? 127 : snr * 4);
+        ++stats.outcomes[rx.outcome];
+        out.push_back(rx);
+    }
+
+    // Keep it for deciding the frames it overlapped; drop what no longer can
+    finished.push_back(last);
+    uint64_t oldestStart = UINT64_MAX;
+    for (size_t i = 0; i < onAir.size(); ++i)
+    {
+        if (onAir[i].startUs < oldestStart)
+            oldestStart = onAir[i].startUs;
+    }
+    while (!finished.empty() && finished.front().endUs <= oldestStart)
+        finished.pop_front();
+    return last;
+}
+
+uint32_t channelTimeOnAirUs(uint8_t len)
+{
+    return loraTimeOnAirUs(len, cfg.spreadingFactor, cfg.bandwidthHz, cfg.codingRate, cfg.preambleLen);
+}
+
+double channelSensitivityDbm()
+{
+    return noiseDbm + requiredSnrDb;
+}
+
+double channelLinkLossDb(uint16_t from, uint16_t to)
+{
+    return linkLoss[from * units + to];
+}
+
+const ChannelStats &channelStats()
+{
+    return stats;
+}
@@ -0,0 +1,103 @@
+// Shared LoRa channel for the multi-node simulator (lora_sim.cpp).
+//
+// All units are on one frequency and spreading factor. A transmission
+// occupies the channel for its time-on-air (airtime.h). Each unit hears it
+// at an RSSI given by log-distance path loss, a fixed shadowing term per
+// link and per-packet fading. When a transmission ends, every other unit
+// either receives it or loses it to one of:
+//   - half duplex: the unit was itself transmitting at some point meanwhile;
+//   - weak: the RSSI draw came out too low for the spreading factor; the
+//     packet error rate goes from ~5% to ~95% over +-3 dB around the
+//     sensitivity;
+//   - collision: other transmissions overlapped it after the receiver had
+//     to lock onto its preamble (its last 5 preamble symbols), and their sum
+//     was less than captureDb below it. A frame captureDb stronger than the
+//     rest survives (capture effect).
+
+#ifndef SIM_CHANNEL_H
+#define SIM_CHANNEL_H
+
+#include <stdint.h>
+#include <vector>
+
+struct ChannelConfig
+{
+    uint8_t spreadingFactor;
+    uint32_t bandwidthHz;
+    uint8_t codingRate; // denominator, 5..8
+    uint16_t preambleLen;
+    double txPowerDbm;
+    double pathLossD0Db; // at d0M
+    double d0M;
+    double pathLossExponent;
+    double shadowingDb; // standard deviation, fixed per link
+    double fadingDb;    // standard deviation, per packet and receiver
+    double noiseFigureDb;
+    double captureDb;
+};
+
+enum RxOutcome
+{
+    RX_OK,
+    RX_HALF_DUPLEX,
+    RX_WEAK,
+    RX_COLLISION,
+    RX_OUTCOMES
+};
+
+struct Transmission
+{
+    uint16_t sender;
+    uint64_t startUs;
+    uint64_t endUs;
+    std::vector<uint8_t> data;
+    std::vector<double> rssi; // dBm at every unit
+    bool overlapped;          // another transmission was on air meanwhile
+};
+
+struct Reception
+{
+    uint16_t unit;
+    RxOutcome outcome;
+    int rssi;
+    int8_t snrQuarterDb;
+};
+
+struct ChannelStats
+{
+    uint32_t transmissions;
+    uint32_t overlapped;            // transmissions that met another on air
+    uint64_t airtimeUs;             // sum over all transmissions
+    uint64_t busyUs;                // time with at least one on air
+    uint32_t outcomes[RX_OUTCOMES]; // per (transmission, other unit)
+};
+
+// Place units at x[i], y[i] metres and clear the channel. seed drives the
+// shadowing and fading draws.
+void channelBegin(const ChannelConfig &config, const std::vector<double> &x, const std::vector<double> &y,
+                  uint32_t seed);
+
+// Put a frame from unit sender on air at startUs. Calls must come in time
+// order; returns the time the frame ends.
+uint64_t channelTransmit(uint16_t sender, uint64_t startUs, const uint8_t *data, uint8_t len);
+
+// Channel activity detection by unit at nowUs: another unit's preamble
+// (or with wholeFrame any part of its frame) is on the air and reaches it
+// above the sensitivity
+bool channelActive(uint16_t unit, uint64_t nowUs, bool wholeFrame);
+
+// End of the earliest transmission still on air, UINT64_MAX if none
+uint64_t channelNextEndUs();
+
+// Take that transmission off the air and decide its fate at every unit in
+// receivers (its sender is skipped). The reference stays valid until the
+// next call.
+const Transmission &channelFinish(const std::vector<uint16_t> &receivers, std::vector<Reception> &out);
+
+uint32_t channelTimeOnAirUs(uint8_t len);
+double channelSensitivityDbm();
+// Mean path loss plus shadowing between two units
+double channelLinkLossDb(uint16_t from, uint16_t to);
+const ChannelStats &channelStats();
+
+#endif // SIM_CHANNEL_H
@@ -0,0 +1,649 @@
+// Discrete-event simulator of many units sharing one LoRa channel.
+//
+// Each unit runs the real sketch: the node library (sketch + native HAL +
+// sim_node.cpp, built with -DPANIC_SIM_NODE) is loaded once per unit from a
+// private copy, so units share no state. Units are scattered over a square
+// area and boot at random times. Scripted panic presses (and optionally
+// button 4 holds) go to random units. Every frame a unit transmits goes
+// through the channel model (channel.h), which hands it to the units that
+// received it. Per value of N the simulator prints:
+//   - frames sent, offered load (airtime sum / duration) and channel busy time;
+//   - transmissions that met another on air, and the fate of receptions
+//     (collision, weak signal, half duplex), also for beacons alone;
+//   - panic latency from the button press until the first unit heard it,
+//     until every unit heard it, and until the ACK reached the sender, as
+//     p50/p90/p99/max over the panics delivered, with the delivered count.
+//
+// Build (from the repository root), then run; tools/sim/sweep.sh builds
+// libraries with other beacon and resend intervals and runs them all:
+//   g++ -std=gnu++11 -O2 -fPIC -shared -fvisibility=hidden -DPANIC_SIM_NODE
+//       -Iinclude -Ilib/frame/src -Itools/sim src/*.cpp lib/frame/src/frame.cpp
+//       tools/sim/sim_node.cpp -o panic_node.so
+//   g++ -std=gnu++11 -O2 -Iinclude -Ilib/frame/src tools/sim/lora_sim.cpp
+//       tools/sim/channel.cpp src/airtime.cpp lib/frame/src/frame.cpp -ldl -o lora_sim
+//   ./lora_sim --lib ./panic_node.so --nodes 2,5,10,20 --seconds 600
+//
+//   --lib PATH        node library (required)
+//   --nodes LIST      comma-separated unit counts, one run each (default 2,5,10,20)
+//   --seconds S       simulated time per run (default 600)
+//   --panics K        panic presses per run (default 10)
+//   --holds K         button 4 holds of 0.5-3 s per run (default 0)
+//   --area-m M        side of the square the units are placed in (default 1000)
+//   --seed X          placement, boot times, script and channel draws (default 1)
+//   --drift-ppm P     unit clocks run up to this much fast or slow; the Nano's
+//                     ceramic resonator is good to a few 1000 ppm (default 2000)
+//   --capture-db D    capture threshold (default 6)
+//   --shadowing-db D  per-link shadowing standard deviation (default 3.6)
+//   --fading-db D     per-packet fading standard deviation (default 2)
+//   --cad-whole-frame CAD detects a frame until its end, not only its
+//                     preamble (the conservative default)
+//   --csv             one CSV line per run instead of the table
+
+#include "sim_node.h"
+#include "channel.h"
+#include "frame.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <vector>
+
+namespace
+{
+#define BOOT_SPREAD_US 10000000ULL // units power up within the first 10 s
+#define WARMUP_US 20000000ULL      // no scripted presses before this
+#define PANIC_BUTTON 4
+#define HOLD_BUTTON 3
+#define NOT_YET UINT64_MAX
+
+struct Options
+{
+    const char *lib;
+    std::vector<unsigned> nodes;
+    unsigned seconds;
+    unsigned panics;
+    unsigned holds;
+    double areaM;
+    uint32_t seed;
+    double driftPpm;
+    double captureDb;
+    double shadowingDb;
+    double fadingDb;
+    bool cadWholeFrame;
+    bool csv;
+};
+
+struct Unit
+{
+    void *handle;
+    const SimNodeApi *api;
+    uint8_t nodeId;
+    uint64_t bootAtUs; // global time of power-on
+    double rate;       // unit clock = (global - bootAt) * rate
+    bool booted;
+    uint64_t wakeUs;   // global time of its next loop() pass
+    uint32_t wakeVersion;
+    int pendingPanic;  // panic pressed but not yet seen on air, else -1
+    int lastPanic;     // its latest panic, else -1
+};
+
+struct Panic
+{
+    uint16_t unit;
+    uint64_t pressUs;
+    int seq; // -1 until the first frame went out
+    std::vector<uint64_t> heardUs; // per unit
+    uint64_t ackUs;
+    bool superseded; // the unit panicked again before this one was acknowledged
+};
+
+enum EventKind
+{
+    EV_TX_END, // first, so a frame ends before anyone acts at the same time
+    EV_BUTTON,
+    EV_BOOT,
+    EV_WAKE
+};
+
+struct Event
+{
+    uint64_t atUs;
+    uint8_t kind;
+    uint16_t unit;
+    uint32_t version; // EV_WAKE: stale unless it matches the unit's
+    uint8_t button;
+    bool pressed;
+
+    bool operator>(const Event &o) const
+    {
+        return atUs != o.atUs ? atUs > o.atUs : kind > o.kind;
+    }
+};
+
+typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event> > EventQueue;
+
+struct RunResult
+{
+    unsigned nodes;
+    SimNodeApi api; // profile and intervals only, the library is unloaded
+    ChannelStats channel;
+    uint32_t sentByType[8];
+    uint32_t beaconOutcomes[RX_OUTCOMES];
+    uint32_t lbtChecks; // summed over the units
+    uint32_t lbtBusy;
+    uint32_t lbtForced;
+    uint64_t lbtBackoffMs;
+    std::vector<double> firstHeardS;
+    std::vector<double> allHeardS;
+    std::vector<double> ackS;
+    unsigned panics; // not superseded
+};
+
+void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s --lib PATH [--nodes LIST] [--seconds S] [--panics K] [--holds K]\n"
+            "          [--area-m M] [--seed X] [--drift-ppm P] [--capture-db D] [--shadowing-db D]\n"
+            "          [--fading-db D] [--cad-whole-frame] [--csv]\n",
+            prog);
+    exit(2);
+}
+
+// A private copy of the node library, so its globals are this unit's own
+bool loadUnit(const char *lib, Unit &unit)
+{
+    char path[] = "/tmp/panic_node_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return false;
+    FILE *in = fopen(lib, "rb");
+    if (in == NULL)
+    {
+        close(fd);
+        unlink(path);
+        return false;
+    }
+    char buf[65536];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+        ok = write(fd, buf, n) == (ssize_t)n;
+    fclose(in);
+    close(fd);
+
+    unit.handle = ok ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : NULL;
+    unlink(path); // the mapping stays
+    if (unit.handle == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", lib, ok ? dlerror() : "copy failed");
+        return false;
+    }
+    unit.api = (const SimNodeApi *)dlsym(unit.handle, SIM_NODE_API_SYMBOL);
+    if (unit.api == NULL || unit.api->version != SIM_NODE_API_VERSION)
+    {
+        fprintf(stderr, "%s: not a node library of this version\n", lib);
+        return false;
+    }
+    return true;
+}
+
+// Global time and channel model behind the units' CADs; a unit only runs
+// CAD from loop(), so the time is that of the pass being run
+uint64_t cadNowUs = 0;
+bool cadWholeFrame = false;
+
+bool cadProbe(void *ctx)
+{
+    return channelActive((uint16_t)(uintptr_t)ctx, cadNowUs, cadWholeFrame);
+}
+
+void scheduleWake(EventQueue &events, Unit &unit, uint16_t index, uint64_t atUs)
+{
+    unit.wakeUs = atUs;
+    ++unit.wakeVersion;
+    if (atUs == UINT64_MAX)
+        return;
+    Event ev = {atUs, EV_WAKE, index, unit.wakeVersion, 0, false};
+    events.push(ev);
+}
+
+// Bring a unit's clock to global time atUs
+void catchUp(Unit &unit, uint64_t atUs)
+{
+    if (atUs > unit.bootAtUs)
+        unit.api->advanceTo((uint64_t)((atUs - unit.bootAtUs) * unit.rate));
+}
+
+// Global time of the unit's next loop() pass, no earlier than nowUs
+uint64_t wakeTime(const Unit &unit, uint64_t nowUs)
+{
+    uint64_t localUs = unit.api->nextWakeUs();
+    if (localUs == UINT64_MAX)
+        return UINT64_MAX;
+    uint64_t atUs = unit.bootAtUs + (uint64_t)ceil(localUs / unit.rate);
+    return atUs > nowUs ? atUs : nowUs + 1;
+}
+
+void pushButton(EventQueue &events, uint16_t unit, uint8_t button, uint64_t atUs, uint64_t holdUs)
+{
+    Event press = {atUs, EV_BUTTON, unit, 0, button, true};
+    Event release = {atUs + holdUs, EV_BUTTON, unit, 0, button, false};
+    events.push(press);
+    events.push(release);
+}
+
+bool simulate(const Options &opt, unsigned nodeCount, RunResult &result)
+{
+    std::mt19937 rng(opt.seed * 7919 + nodeCount);
+    std::vector<Unit> units(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i)
+    {
+        if (!loadUnit(opt.lib, units[i]))
+            return false;
+        units[i].nodeId = (uint8_t)(i + 1);
+        units[i].booted = false;
+        units[i].wakeUs = UINT64_MAX;
+        units[i].wakeVersion = 0;
+        units[i].pendingPanic = -1;
+        units[i].lastPanic = -1;
+        units[i].api->setCadProbe(cadProbe, (void *)(uintptr_t)i);
+    }
+    cadWholeFrame = opt.cadWholeFrame;
+    const SimNodeApi *api = units[0].api;
+
+    ChannelConfig cfg;
+    cfg.spreadingFactor = api->spreadingFactor;
+    cfg.bandwidthHz = api->bandwidthHz;
+    cfg.codingRate = api->codingRate;
+    cfg.preambleLen = api->preambleLen;
+    cfg.txPowerDbm = api->txPowerDbm;
+    // Log-distance model measured for LoRa in a built-up area (Bor et al.,
+    // "Do LoRa low-power wide-area networks scale?", 2016)
+    cfg.pathLossD0Db = 127.41;
+    cfg.d0M = 40.0;
+    cfg.pathLossExponent = 2.08;
+    cfg.shadowingDb = opt.shadowingDb;
+    cfg.fadingDb = opt.fadingDb;
+    cfg.noiseFigureDb = 6.0;
+    cfg.captureDb = opt.captureDb;
+
+    std::uniform_real_distribution<double> place(0.0, opt.areaM);
+    std::vector<double> x(nodeCount), y(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i)
+    {
+        x[i] = place(rng);
+        y[i] = place(rng);
+    }
+    channelBegin(cfg, x, y, opt.seed * 104729 + nodeCount);
+
+    EventQueue events;
+    std::uniform_int_distribution<uint64_t> bootAt(0, BOOT_SPREAD_US);
+    std::uniform_real_distribution<double> drift(-opt.driftPpm, opt.driftPpm);
+    for (unsigned i = 0; i < nodeCount; ++i)
+    {
+        units[i].bootAtUs = bootAt(rng);
+        units[i].rate = 1.0 + drift(rng) / 1e6;
+        Event ev = {units[i].bootAtUs, EV_BOOT, (uint16_t)i, 0, 0, false};
+        events.push(ev);
+    }
+
+    // Presses in the first three quarters, so late panics still have time
+    uint64_t endUs = (uint64_t)opt.seconds * 1000000;
+    uint64_t scriptEndUs = WARMUP_US + (endUs > WARMUP_US ? (endUs - WARMUP_US) * 3 / 4 : 0);
+    std::uniform_int_distribution<uint64_t> scriptAt(WARMUP_US, scriptEndUs);
+    std::uniform_int_distribution<unsigned> anyUnit(0, nodeCount - 1);
+    std::uniform_int_distribution<uint64_t> holdFor(500000, 3000000);
+    // Panics go round a shuffled list of the units, so a unit panics again
+    // only once every unit has
+    std::vector<uint16_t> panicOrder(nodeCount);
+    for (unsigned i = 0; i < nodeCount; ++i)
+        panicOrder[i] = (uint16_t)i;
+    std::shuffle(panicOrder.begin(), panicOrder.end(), rng);
+    for (unsigned p = 0; p < opt.panics; ++p)
+        pushButton(events, panicOrder[p % nodeCount], PANIC_BUTTON, scriptAt(rng), 100000);
+    for (unsigned h = 0; h < opt.holds; ++h)
+        pushButton(events, (uint16_t)anyUnit(rng), HOLD_BUTTON, scriptAt(rng), holdFor(rng));
+
+    std::vector<Panic> panics;
+    std::vector<uint16_t> listening;
+    std::vector<Reception> receptions;
+    memset(result.sentByType, 0, sizeof(result.sentByType));
+    memset(result.beaconOutcomes, 0, sizeof(result.beaconOutcomes));
+
+    while (!events.empty() && events.top().atUs < endUs)
+    {
+        Event ev = events.top();
+        events.pop();
+        Unit &unit = units[ev.unit];
+
+        if (ev.kind == EV_BOOT)
+        {
+            unit.api->boot(unit.nodeId, opt.seed * 65599 + ev.unit);
+            unit.booted = true;
+            scheduleWake(events, unit, ev.unit, wakeTime(unit, ev.atUs));
+        }
+        else if (ev.kind == EV_BUTTON)
+        {
+            if (!unit.booted)
+                continue;
+            catchUp(unit, ev.atUs);
+            unit.api->setButton(ev.button, ev.pressed);
+            if (ev.button == PANIC_BUTTON && ev.pressed)
+            {
+                Panic p;
+                p.unit = ev.unit;
+                p.pressUs = ev.atUs;
+                p.seq = -1;
+                p.heardUs.assign(nodeCount, NOT_YET);
+                p.ackUs = NOT_YET;
+                p.superseded = false;
+                // A new sequence number: the unit gives up on the old panic
+                if (unit.lastPanic >= 0 && panics[unit.lastPanic].ackUs == NOT_YET)
+                    panics[unit.lastPanic].superseded = true;
+                unit.pendingPanic = unit.lastPanic = (int)panics.size();
+                panics.push_back(p);
+            }
+            if (ev.atUs < unit.wakeUs)
+                scheduleWake(events, unit, ev.unit, ev.atUs);
+        }
+        else if (ev.kind == EV_WAKE)
+        {
+            if (ev.version != unit.wakeVersion)
+                continue;
+            catchUp(unit, ev.atUs);
+            cadNowUs = ev.atUs;
+            unit.api->loop();
+
+            uint8_t data[256];
+            uint8_t len;
+            while (unit.api->takeSent(data, &len))
+            {
+                uint64_t endsUs = channelTransmit(ev.unit, ev.atUs, data, len);
+                Event end = {endsUs, EV_TX_END, ev.unit, 0, 0, false};
+                events.push(end);
+
+                Frame f;
+                if (!frameDecode(data, len, f, false))
+                    continue;
+                ++result.sentByType[f.type & 7];
+                if (f.type == FRAME_PANIC && f.hops == 0 && unit.pendingPanic >= 0)
+                {
+                    panics[unit.pendingPanic].seq = f.seq;
+                    unit.pendingPanic = -1;
+                }
+            }
+            scheduleWake(events, unit, ev.unit, wakeTime(unit, ev.atUs));
+        }
+        else // EV_TX_END
+        {
+            listening.clear();
+            for (unsigned i = 0; i < nodeCount; ++i)
+            {
+                if (units[i].booted)
+                    listening.push_back((uint16_t)i);
+            }
+            const Transmission &t = channelFinish(listening, receptions);
+            Frame f;
+            bool decoded = frameDecode(t.data.data(), (uint8_t)t.data.size(), f, false);
+
+            for (size_t r = 0; r < receptions.size(); ++r)
+            {
+                const Reception &rx = receptions[r];
+                if (decoded && f.type == FRAME_BEACON)
+                    ++result.beaconOutcomes[rx.outcome];
+                if (rx.outcome != RX_OK)
+                    continue;
+                Unit &to = units[rx.unit];
+                catchUp(to, ev.atUs);
+                to.api->inject(t.data.data(), (uint8_t)t.data.size(), rx.rssi, rx.snrQuarterDb);
+                if (ev.atUs < to.wakeUs)
+                    scheduleWake(events, to, rx.unit, ev.atUs);
+
+                if (!decoded || f.seq == 0)
+                    continue;
+                // Latest panic with this origin and sequence number
+                for (size_t p = panics.size(); p-- > 0;)
+                {
+                    Panic &panic = panics[p];
+                    if (panic.seq != f.seq || units[panic.unit].nodeId != (f.type == FRAME_ACK ? f.target : f.node))
+                        continue;
+                    if (f.type == FRAME_PANIC && panic.heardUs[rx.unit] == NOT_YET)
+                        panic.heardUs[rx.unit] = ev.atUs;
+                    else if (f.type == FRAME_ACK && rx.unit == panic.unit && panic.ackUs == NOT_YET)
+                        panic.ackUs = ev.atUs;
+                    break;
+                }
+            }
+        }
+    }
+
+    result.nodes = nodeCount;
+    result.api = *api;
+    result.channel = channelStats();
+    result.panics = 0;
+    result.firstHeardS.clear();
+    result.allHeardS.clear();
+    result.ackS.clear();
+    for (size_t p = 0; p < panics.size(); ++p)
+    {
+        const Panic &panic = panics[p];
+        if (panic.superseded)
+            continue;
+        ++result.panics;
+        uint64_t first = NOT_YET;
+        uint64_t all = 0;
+        for (unsigned i = 0; i < nodeCount; ++i)
+        {
+            if (i == panic.unit)
+                continue;
+            first = std::min(first, panic.heardUs[i]);
+            all = std::max(all, panic.heardUs[i]);
+        }
+        if (first != NOT_YET)
+            result.firstHeardS.push_back((first - panic.pressUs) / 1e6);
+        if (nodeCount > 1 && all != NOT_YET)
+            result.allHeardS.push_back((all - panic.pressUs) / 1e6);
+        if (panic.ackUs != NOT_YET)
+            result.ackS.push_back((panic.ackUs - panic.pressUs) / 1e6);
+    }
+
+    result.lbtChecks = result.lbtBusy = result.lbtForced = 0;
+    result.lbtBackoffMs = 0;
+    for (unsigned i = 0; i < nodeCount; ++i)
+    {
+        uint32_t checks, busy, forced, backoffMs;
+        units[i].api->lbtStats(&checks, &busy, &forced, &backoffMs);
+        result.lbtChecks += checks;
+        result.lbtBusy += busy;
+        result.lbtForced += forced;
+        result.lbtBackoffMs += backoffMs;
+        dlclose(units[i].handle);
+    }
+    return true;
+}
+
+// Nearest-rank percentile of sorted values
+double percentile(const std::vector<double> &sorted, unsigned pct)
+{
+    if (sorted.empty())
+        return NAN;
+    size_t rank = (sorted.size() * pct + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// "delivered p50 p90 p99 max" of one latency, in seconds
+void latencyColumns(char *out, size_t size, std::vector<double> values, unsigned total, bool csv)
+{
+    std::sort(values.begin(), values.end());
+    double maxS = values.empty() ? NAN : values.back();
+    if (csv)
+        snprintf(out, size, "%u,%.2f,%.2f,%.2f,%.2f", (unsigned)values.size(), percentile(values, 50),
+                 percentile(values, 90), percentile(values, 99), maxS);
+    else
+        snprintf(out, size, "%3u/%-3u %6.2f %6.2f %6.2f %6.2f", (unsigned)values.size(), total,
+                 percentile(values, 50), percentile(values, 90), percentile(values, 99), maxS);
+}
+
+void printResult(const Options &opt, const RunResult &r, bool header)
+{
+    const ChannelStats &c = r.channel;
+    double seconds = opt.seconds;
+    uint32_t receptions = 0;
+    for (int o = 0; o < RX_OUTCOMES; ++o)
+        receptions += c.outcomes[o];
+    // Collisions and weak signals among receptions not lost to half duplex
+    uint32_t contended = receptions - c.outcomes[RX_HALF_DUPLEX];
+    double collidePct = contended ? 100.0 * c.outcomes[RX_COLLISION] / contended : 0;
+    double weakPct = contended ? 100.0 * c.outcomes[RX_WEAK] / contended : 0;
+    double halfPct = receptions ? 100.0 * c.outcomes[RX_HALF_DUPLEX] / receptions : 0;
+    double overlapPct = c.transmissions ? 100.0 * c.overlapped / c.transmissions : 0;
+    double loadPct = 100.0 * c.airtimeUs / 1e6 / seconds;
+    double busyPct = 100.0 * c.busyUs / 1e6 / seconds;
+    // Goodput: frames received intact, counted once per receiving unit
+    double goodPerMin = c.outcomes[RX_OK] * 60.0 / seconds;
+    double lbtBusyPct = r.lbtChecks ? 100.0 * r.lbtBusy / r.lbtChecks : 0;
+    const uint32_t *b = r.beaconOutcomes;
+    uint32_t beaconContended = b[RX_OK] + b[RX_WEAK] + b[RX_COLLISION];
+    double beaconCollidePct = beaconContended ? 100.0 * b[RX_COLLISION] / beaconContended : 0;
+
+    char first[80], all[80], ack[80];
+    latencyColumns(first, sizeof(first), r.firstHeardS, r.panics, opt.csv);
+    latencyColumns(all, sizeof(all), r.allHeardS, r.panics, opt.csv);
+    latencyColumns(ack, sizeof(ack), r.ackS, r.panics, opt.csv);
+
+    if (opt.csv)
+    {
+        if (header)
+            printf("nodes,sf,beacon_ms,panic_retry_ms,hold_resend_ms,seconds,frames,beacons,panics_tx,acks,"
+                   "load_pct,busy_pct,overlap_pct,collide_pct,weak_pct,half_duplex_pct,good_per_min,"
+                   "lbt,lbt_cads,lbt_busy_pct,lbt_forced,lbt_backoff_s,slotted,beacon_collide_pct,panics,"
+                   "first_n,first_p50,first_p90,first_p99,first_max,all_n,all_p50,all_p90,all_p99,all_max,"
+                   "ack_n,ack_p50,ack_p90,ack_p99,ack_max\n");
+        printf("%u,%u,%lu,%lu,%lu,%u,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%d,%lu,%.1f,%lu,%.1f,"
+               "%d,%.1f,%u,%s,%s,%s\n",
+               r.nodes,
+               r.api.spreadingFactor, (unsigned long)r.api.beaconIntervalMs, (unsigned long)r.api.panicRetryMs,
+               (unsigned long)r.api.holdResendMs, opt.seconds, (unsigned long)c.transmissions,
+               (unsigned long)r.sentByType[FRAME_BEACON], (unsigned long)r.sentByType[FRAME_PANIC],
+               (unsigned long)r.sentByType[FRAME_ACK], loadPct, busyPct, overlapPct, collidePct, weakPct, halfPct,
+               goodPerMin, r.api.listenBeforeTalk ? 1 : 0, (unsigned long)r.lbtChecks, lbtBusyPct,
+               (unsigned long)r.lbtForced, r.lbtBackoffMs / 1000.0, r.api.slottedBeacons ? 1 : 0, beaconCollidePct,
+               r.panics, first, all, ack);
+        return;
+    }
+
+    if (header)
+    {
+        printf("SF%u, beacon %s %lu ms, panic retry %lu ms, hold resend %lu ms, LBT %s, %u s per run, "
+               "sensitivity %.1f dBm\n",
+               r.api.spreadingFactor, r.api.slottedBeacons ? "slotted, superframe" : "every",
+               (unsigned long)r.api.beaconIntervalMs, (unsigned long)r.api.panicRetryMs,
+               (unsigned long)r.api.holdResendMs, r.api.listenBeforeTalk ? "on" : "off", opt.seconds,
+               channelSensitivityDbm());
+        printf("                 channel %%            receptions %%      |  panic latency s: delivered  p50    p90"
+               "    p99    max\n");
+        printf("nodes frames  load  busy overlap  collide weak half |\n");
+    }
+    printf("%5u %6lu %5.1f %5.1f %7.1f  %7.1f %4.1f %4.1f |  first unit   %s\n", r.nodes,
+           (unsigned long)c.transmissions, loadPct, busyPct, overlapPct, collidePct, weakPct, halfPct, first);
+    char left[80];
+    snprintf(left, sizeof(left), "      goodput %.1f frames/min, beacons collide %.1f%%", goodPerMin,
+             beaconCollidePct);
+    printf("%-52s|  all units    %s\n", left, all);
+    left[0] = '\0';
+    if (r.api.listenBeforeTalk)
+        snprintf(left, sizeof(left), "      lbt busy %.1f%%, %lu forced, %.0f s back-off", lbtBusyPct,
+                 (unsigned long)r.lbtForced, r.lbtBackoffMs / 1000.0);
+    printf("%-52s|  ACK back     %s\n", left, ack);
+}
+
+std::vector<unsigned> parseList(const char *arg)
+{
+    std::vector<unsigned> values;
+    while (*arg)
+    {
+        char *end;
+        unsigned long v = strtoul(arg, &end, 10);
+        if (end == arg)
+            break;
+        values.push_back((unsigned)v);
+        arg = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    opt.lib = NULL;
+    opt.nodes = parseList("2,5,10,20");
+    opt.seconds = 600;
+    opt.panics = 10;
+    opt.holds = 0;
+    opt.areaM = 1000;
+    opt.seed = 1;
+    opt.driftPpm = 2000;
+    opt.captureDb = 6;
+    opt.shadowingDb = 3.6;
+    opt.fadingDb = 2;
+    opt.cadWholeFrame = false;
+    opt.csv = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (strcmp(arg, "--lib") == 0 && hasValue)
+            opt.lib = argv[++i];
+        else if (strcmp(arg, "--nodes") == 0 && hasValue)
+            opt.nodes = parseList(argv[++i]);
+        else if (strcmp(arg, "--seconds") == 0 && hasValue)
+            opt.seconds = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--panics") == 0 && hasValue)
+            opt.panics = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--holds") == 0 && hasValue)
+            opt.holds = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--area-m") == 0 && hasValue)
+            opt.areaM = atof(argv[++i]);
+        else if (strcmp(arg, "--seed") == 0 && hasValue)
+            opt.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--drift-ppm") == 0 && hasValue)
+            opt.driftPpm = atof(argv[++i]);
+        else if (strcmp(arg, "--capture-db") == 0 && hasValue)
+            opt.captureDb = atof(argv[++i]);
+        else if (strcmp(arg, "--shadowing-db") == 0 && hasValue)
+            opt.shadowingDb = atof(argv[++i]);
+        else if (strcmp(arg, "--fading-db") == 0 && hasValue)
+            opt.fadingDb = atof(argv[++i]);
+        else if (strcmp(arg, "--cad-whole-frame") == 0)
+            opt.cadWholeFrame = true;
+        else if (strcmp(arg, "--csv") == 0)
+            opt.csv = true;
+        else
+            usage(argv[0]);
+    }
+    if (opt.lib == NULL || opt.nodes.empty() || opt.seconds == 0)
+        usage(argv[0]);
+
+    for (size_t n = 0; n < opt.nodes.size(); ++n)
+    {
+        if (opt.nodes[n] < 1 || opt.nodes[n] > 254)
+        {
+            fprintf(stderr, "node counts must be 1..254\n");
+            return 2;
+        }
+        RunResult result;
+        if (!simulate(opt, opt.nodes[n], result))
+            return 1;
+        printResult(opt, result, n == 0);
+        fflush(stdout);
+    }
+    return 0;
+}
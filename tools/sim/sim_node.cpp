@@ -0,0 +1,127 @@
+// Glue between the sketch and the channel simulator, built into the node
+// library together with src/ and lib/frame (see sim_node.h and lora_sim.cpp).
+
+#ifdef PANIC_SIM_NODE
+
+#include "sim_node.h"
+#include "hal.h"
+#include "sim.h"
+#include "scheduler.h"
+#include "tx_queue.h"
+#include "beacon_slots.h"
+
+#include <stdio.h>
+
+#ifndef STATS
+#error "the simulator reads the listen-before-talk counters: build without NO_STATS"
+#endif
+
+void setup();
+void loop();
+
+namespace
+{
+void boot(uint8_t nodeId, uint32_t seed)
+{
+    sim::reset();
+    sim::setSerialEcho(false);
+    sim::setEntropySeed(seed);
+
+    // A provisioned unit: fixed node ID and the name "UNIT <id>"
+    uint8_t *eeprom = sim::eeprom();
+    char name[NAME_MAX_LEN + 1];
+    snprintf(name, sizeof(name), "UNIT %-7u", (unsigned)nodeId);
+    for (uint8_t i = 0; i < NAME_MAX_LEN; ++i)
+        eeprom[NAME_EEPROM_ADDR + i] = name[i];
+    eeprom[NODE_ID_EEPROM_ADDR] = nodeId;
+
+    setup();
+}
+
+uint64_t nowUs()
+{
+    return sim::nowUs();
+}
+
+void advanceTo(uint64_t us)
+{
+    uint64_t now = sim::nowUs();
+    if (us > now)
+        sim::advanceUs(us - now);
+}
+
+uint64_t nextWakeUs()
+{
+    uint64_t now = sim::nowUs();
+    // Frames waiting for TxDone or a relay back-off: poll as loop() would
+    if (txQueueDepth() > 0)
+        return now + 1000;
+    uint32_t ms = hal::millis();
+    uint32_t dueIn = schedDueIn(ms);
+    if (dueIn == 0xFFFFFFFF)
+        return UINT64_MAX;
+    uint64_t due = ((uint64_t)ms + dueIn) * 1000;
+    return due > now ? due : now + 100;
+}
+
+void setButton(uint8_t index, bool pressed)
+{
+    if (index < 5)
+        sim::setButton(PINS.button[index], pressed);
+}
+
+void inject(const uint8_t *data, uint8_t len, int rssi, int8_t snrQuarterDb)
+{
+    sim::radioInject(data, len, rssi, snrQuarterDb);
+}
+
+void lbtStats(uint32_t *checks, uint32_t *busy, uint32_t *forced, uint32_t *backoffMs)
+{
+#ifdef LISTEN_BEFORE_TALK
+    *checks = txLbtChecks();
+    *busy = txLbtBusy();
+    *forced = txLbtForced();
+    *backoffMs = txLbtBackoffMs();
+#else
+    *checks = *busy = *forced = *backoffMs = 0;
+#endif
+}
+}
+
+extern "C" __attribute__((visibility("default"))) const SimNodeApi simNodeApi = {
+    SIM_NODE_API_VERSION,
+    RADIO.spreadingFactor,
+    RADIO.bandwidthHz,
+    RADIO.codingRate,
+    LORA_PREAMBLE_LEN,
+    RADIO.txPowerDbm,
+#ifdef TDMA_BEACONS
+    TDMA_SUPERFRAME_MS,
+#else
+    BEACON_INTERVAL_MS,
+#endif
+    PANIC_RETRY_MS,
+    HOLD_RESEND_MS,
+#ifdef LISTEN_BEFORE_TALK
+    true,
+#else
+    false,
+#endif
+#ifdef TDMA_BEACONS
+    true,
+#else
+    false,
+#endif
+    boot,
+    nowUs,
+    advanceTo,
+    loop,
+    nextWakeUs,
+    setButton,
+    sim::radioTakeSent,
+    inject,
+    sim::setCadProbe,
+    lbtStats,
+};
+
+#endif // PANIC_SIM_NODE
@@ -0,0 +1,57 @@
+// One simulated unit for the channel simulator (lora_sim.cpp).
+//
+// The sketch (src/), the native HAL and sim_node.cpp are built with
+// -DPANIC_SIM_NODE into a shared library. The simulator loads one private
+// copy of it per unit, so every unit has its own globals, virtual clock and
+// radio, and drives it through the table below (the only exported symbol).
+
+#ifndef SIM_NODE_H
+#define SIM_NODE_H
+
+#include <stdint.h>
+
+#define SIM_NODE_API_SYMBOL "simNodeApi"
+#define SIM_NODE_API_VERSION 3
+
+struct SimNodeApi
+{
+    uint16_t version;
+
+    // Radio profile and intervals the library was built with (config.h)
+    uint8_t spreadingFactor;
+    uint32_t bandwidthHz;
+    uint8_t codingRate; // denominator, 5..8
+    uint16_t preambleLen;
+    int8_t txPowerDbm;
+    uint32_t beaconIntervalMs; // the superframe with slotted beacons
+    uint32_t panicRetryMs;
+    uint32_t holdResendMs;
+    bool listenBeforeTalk;
+    bool slottedBeacons; // TDMA_BEACONS
+
+    // Power on with this node ID and entropy seed, then run setup(). The
+    // clock starts at 0; the radio comes up in the first few ms of loop().
+    void (*boot)(uint8_t nodeId, uint32_t seed);
+    // Virtual clock of this unit
+    uint64_t (*nowUs)();
+    // Let time pass up to us (no-op if already there)
+    void (*advanceTo)(uint64_t us);
+    // One loop() pass
+    void (*loop)();
+    // When the unit next has something to do (after a loop() pass): its
+    // earliest scheduler task, or 1 ms while frames wait for the radio
+    uint64_t (*nextWakeUs)();
+
+    // Buttons 0..4 as in the sketch
+    void (*setButton)(uint8_t index, bool pressed);
+    // Next frame the unit put on air since the last call; false if none
+    bool (*takeSent)(uint8_t *data, uint8_t *len);
+    // A frame received over the air, delivered at the current time
+    void (*inject)(const uint8_t *data, uint8_t len, int rssi, int8_t snrQuarterDb);
+    // Answers this unit's channel activity detections (sim::setCadProbe)
+    void (*setCadProbe)(bool (*probe)(void *ctx), void *ctx);
+    // Listen-before-talk counters: CADs, busy CADs, frames forced out, back-off ms
+    void (*lbtStats)(uint32_t *checks, uint32_t *busy, uint32_t *forced, uint32_t *backoffMs);
+};
+
+#endif // SIM_NODE_H
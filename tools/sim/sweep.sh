@@ -0,0 +1,62 @@
+#!/bin/sh
+# Scaling sweep with the channel simulator (tools/sim/lora_sim.cpp): builds
+# one node library per beacon / panic retry interval, listen-before-talk,
+# slotted-beacon and state-beacon setting, and runs each over the unit
+# counts in NODES.
+# Prints CSV on stdout, e.g.
+#   tools/sim/sweep.sh > sweep.csv
+#   NODES=2,10,40 BEACONS="5000 30000" RETRIES=2500 LBT="on off" tools/sim/sweep.sh
+#   SLOTS="off on" tools/sim/sweep.sh
+#   STATE="on off" tools/sim/sweep.sh --holds 60
+# Slotted beacons (TDMA_BEACONS) ignore BEACONS, need LBT on and carry no
+# state snapshot, so those combinations run once.
+# Any other lora_sim options can follow: tools/sim/sweep.sh --holds 20
+
+set -e
+cd "$(dirname "$0")/../.."
+
+NODES=${NODES:-2,5,10,20,40}
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-900}
+BEACONS=${BEACONS:-"5000 15000 60000"}
+RETRIES=${RETRIES:-"2500 5000"}
+LBT=${LBT:-on}
+SLOTS=${SLOTS:-off}
+STATE=${STATE:-on}
+CXX=${CXX:-g++}
+OUT=${OUT:-.pio/sim}
+
+mkdir -p "$OUT"
+$CXX -std=gnu++11 -O2 -Iinclude -Ilib/frame/src tools/sim/lora_sim.cpp tools/sim/channel.cpp \
+    src/airtime.cpp lib/frame/src/frame.cpp -ldl -o "$OUT/lora_sim"
+
+header=1
+first_beacon=${BEACONS%% *}
+first_state=${STATE%% *}
+for beacon in $BEACONS; do
+    for retry in $RETRIES; do
+        for lbt in $LBT; do
+            for slots in $SLOTS; do
+                for state in $STATE; do
+                    if [ "$slots" = on ]; then
+                        [ "$lbt" = off ] || [ "$beacon" != "$first_beacon" ] || [ "$state" != "$first_state" ] &&
+                            continue
+                    fi
+                    lib="$OUT/panic_node_b${beacon}_r${retry}_lbt${lbt}_slots${slots}_state${state}.so"
+                    flags="-DBEACON_INTERVAL_MS=$beacon -DPANIC_RETRY_MS=$retry"
+                    [ "$lbt" = off ] && flags="$flags -DNO_LISTEN_BEFORE_TALK"
+                    [ "$slots" = on ] && flags="$flags -DTDMA_BEACONS"
+                    [ "$state" = off ] && flags="$flags -DNO_STATE_BEACONS"
+                    $CXX -std=gnu++11 -O2 -fPIC -shared -fvisibility=hidden -DPANIC_SIM_NODE $flags \
+                        -Iinclude -Ilib/frame/src -Itools/sim src/*.cpp lib/frame/src/frame.cpp tools/sim/sim_node.cpp \
+                        -o "$lib"
+                    if [ $header = 1 ]; then
+                        "$OUT/lora_sim" --lib "$lib" --nodes "$NODES" --seconds "$SECONDS_PER_RUN" --csv "$@"
+                        header=0
+                    else
+                        "$OUT/lora_sim" --lib "$lib" --nodes "$NODES" --seconds "$SECONDS_PER_RUN" --csv "$@" | tail -n +2
+                    fi
+                done
+            done
+        done
+    done
+done
@@ -0,0 +1,42 @@
+# PlatformIO post-build check: fail the build when the firmware outgrows the
+# static RAM or flash budget set in platformio.ini (custom_ram_budget,
+# custom_flash_budget). PlatformIO's own size check only warns about RAM, and
+# on the 168 whatever static RAM is left over is all the stack gets.
+
+Import("env")
+
+import subprocess
+
+
+def section_sizes(elf):
+    """Section name -> size in bytes, from `avr-size -A`."""
+    out = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+    sizes = {}
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def check_budget(source, target, env):
+    sizes = section_sizes(str(target[0]))
+    ram = sizes.get(".data", 0) + sizes.get(".bss", 0) + sizes.get(".noinit", 0)
+    flash = sizes.get(".text", 0) + sizes.get(".data", 0)
+    ram_budget = int(env.GetProjectOption("custom_ram_budget"))
+    flash_budget = int(env.GetProjectOption("custom_flash_budget"))
+
+    print("%s: static RAM %d of %d bytes budget, flash %d of %d bytes budget"
+          % (env["PIOENV"], ram, ram_budget, flash, flash_budget))
+    over = []
+    if ram > ram_budget:
+        over.append("static RAM over budget by %d bytes" % (ram - ram_budget))
+    if flash > flash_budget:
+        over.append("flash over budget by %d bytes" % (flash - flash_budget))
+    if over:
+        print("Error: " + ", ".join(over))
+        return 1
+    return 0
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_budget)
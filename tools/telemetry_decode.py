@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+# Decode the binary telemetry stream of a TELEMETRY build (include/telemetry.h)
+# into CSV, one row per record. Reads a serial port (needs pyserial), a
+# captured file, or stdin:
+#   tools/telemetry_decode.py /dev/ttyUSB0 > run.csv
+#   tools/telemetry_decode.py capture.bin > run.csv
+#   .pio/build/native/program --loops 100000 | tools/telemetry_decode.py - > run.csv
+# Bytes outside a valid record (replies to serial commands, line noise) are
+# skipped; the count goes to stderr at the end.
+
+import argparse
+import csv
+import struct
+import sys
+
+SYNC = 0xA5
+EVENT, FRAME, STATS = 1, 2, 3
+
+# Same order as JournalEvent (journal.h) and the TEL_EVENT_* codes
+EVENTS = {0: "boot", 1: "panic", 2: "acked", 3: "heard", 4: "up", 5: "lost",
+          0x10: "button_down", 0x11: "button_up"}
+# Same order as FrameType (lib/frame/src/frame.h)
+FRAMES = {0: "press", 1: "release", 2: "panic", 3: "beacon", 4: "beep", 5: "ack", 0xFF: "undecoded"}
+
+COLUMNS = ["ms", "record", "event", "node", "arg", "frame", "rssi", "snr_db", "len",
+           "loop_passes", "tx_depth", "rx_dropped", "records_dropped", "lcd_stalls", "stack_free"]
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def decode(rtype, payload):
+    """One CSV row (dict) for a record, or None for an unknown type."""
+    if rtype == EVENT and len(payload) == 8:
+        ms, event, node, rssi, arg = struct.unpack("<IBBbB", payload)
+        return {"ms": ms, "record": "event", "event": EVENTS.get(event, event), "node": node,
+                "rssi": rssi if rssi != 0 else "", "arg": arg}
+    if rtype == FRAME and len(payload) == 9:
+        ms, ftype, node, rssi, snr, length = struct.unpack("<IBBbbB", payload)
+        return {"ms": ms, "record": "frame", "frame": FRAMES.get(ftype, ftype), "node": node,
+                "rssi": rssi, "snr_db": snr / 4.0, "len": length}
+    if rtype == STATS and len(payload) == 15:
+        ms, passes, depth, rx_dropped, dropped, stalls, stack = struct.unpack("<IHBHHHH", payload)
+        return {"ms": ms, "record": "stats", "loop_passes": passes, "tx_depth": depth,
+                "rx_dropped": rx_dropped, "records_dropped": dropped, "lcd_stalls": stalls,
+                "stack_free": stack}
+    return None
+
+
+def records(chunks):
+    """Yield (type, payload) for every valid record in a stream of byte chunks;
+    the number of skipped bytes is in records.skipped afterwards."""
+    buf = bytearray()
+    records.skipped = 0
+    for chunk in chunks:
+        buf += chunk
+        while True:
+            start = buf.find(SYNC)
+            if start < 0:
+                records.skipped += len(buf)
+                buf.clear()
+                break
+            records.skipped += start
+            del buf[:start]
+            if len(buf) < 3 or len(buf) < 4 + buf[2]:
+                break  # wait for the rest
+            end = 3 + buf[2]
+            if crc8(buf[1:end]) != buf[end]:
+                records.skipped += 1
+                del buf[:1]  # not a record start after all
+                continue
+            yield buf[1], bytes(buf[3:end])
+            del buf[:end + 1]
+    records.skipped += len(buf)
+
+
+def read_chunks(source, baud):
+    if source == "-":
+        stream = sys.stdin.buffer
+    elif source.startswith("/dev/") or source.upper().startswith("COM"):
+        import serial  # pyserial
+        stream = serial.Serial(source, baud, timeout=1)
+    else:
+        stream = open(source, "rb")
+    while True:
+        chunk = stream.read(256) if source != "-" else stream.read1(256)
+        if not chunk:
+            if hasattr(stream, "in_waiting"):
+                continue  # serial port: keep listening until ^C
+            return
+        yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Telemetry stream to CSV")
+    parser.add_argument("source", help="serial port, capture file, or - for stdin")
+    parser.add_argument("--baud", type=int, default=115200, help="TELEMETRY_BAUD (default 115200)")
+    args = parser.parse_args()
+
+    out = csv.DictWriter(sys.stdout, fieldnames=COLUMNS)
+    out.writeheader()
+    count = 0
+    try:
+        for rtype, payload in records(read_chunks(args.source, args.baud)):
+            row = decode(rtype, payload)
+            if row is not None:
+                out.writerow(row)
+                sys.stdout.flush()
+                count += 1
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("%d records, %d bytes skipped\n" % (count, records.skipped))
+
+
+if __name__ == "__main__":
+    main()